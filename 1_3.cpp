@@ -1,5 +1,68 @@
 ﻿#include <iostream>
 #include <string>
+#include <cstdint>
+#include <ctime>
+#include <random>
+
+// Генератор xoshiro256**: у каждого потока свой, поэтому броски не требуют блокировок
+// и воспроизводятся по зерну
+class FastRandom
+{
+private:
+    uint64_t state[4];
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+public:
+    explicit FastRandom(uint64_t seed = 0) { reseed(seed); }
+
+    void reseed(uint64_t seed)
+    {
+        for (uint64_t& word : state)
+        {
+            // splitmix64 для расширения зерна
+            uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t next()
+    {
+        const uint64_t result = rotl(state[1] * 5, 7) * 9;
+        const uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
+    }
+
+    // Равномерное число из [0, bound) без смещения (метод Лемира)
+    uint32_t below(uint32_t bound)
+    {
+        uint64_t m = (next() >> 32) * bound;
+        if (static_cast<uint32_t>(m) < bound)
+        {
+            const uint32_t threshold = (0u - bound) % bound;
+            while (static_cast<uint32_t>(m) < threshold)
+            {
+                m = (next() >> 32) * bound;
+            }
+        }
+        return static_cast<uint32_t>(m >> 32);
+    }
+};
+
+// Генератор текущего потока
+inline FastRandom& gameRandom()
+{
+    thread_local FastRandom random(std::random_device{}());
+    return random;
+}
 
 class Entity
 {
@@ -69,7 +132,7 @@ public:
         if (damage > 0)
         {
             // Шанс на критический удар (20%)
-            if (rand() % 100 < 20)
+            if (gameRandom().below(100) < 20)
             {
                 damage *= 2;
                 std::cout << "Critical hit! ";
@@ -114,7 +177,7 @@ public:
         if (damage > 0)
         {
             // Шанс на ядовитую атаку (30%)
-            if (rand() % 100 < 30)
+            if (gameRandom().below(100) < 30)
             {
                 damage += 5; // Дополнительный урон от яда
                 std::cout << "Poisonous attack! ";
@@ -160,7 +223,7 @@ public:
 };
 
 int main() {
-    srand(static_cast<unsigned>(time(0))); // Инициализация генератора случайных чисел
+    gameRandom().reseed(static_cast<uint64_t>(time(0))); // Инициализация генератора случайных чисел
 
     // Создание объектов
     Character hero("Hero", 100, 20, 10);
@@ -1,14 +1,556 @@
 ﻿#include <memory>
 #include <string>
 #include <iostream>
-class Inventory {
+#include <utility>
+#include <chrono>
+#include <vector>
+#include <array>
+#include <optional>
+#include <unordered_map>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <cstdint>
+
+enum class ItemType { Misc, Weapon, Armor, Consumable, Ammo };
+constexpr size_t kItemTypes = 5;
+
+struct Item {
+    std::string name;
+    ItemType type;
+
+    Item(std::string n, ItemType t = ItemType::Misc) : name(std::move(n)), type(t) {}
+};
+
+// How many items of each name and each type an inventory holds, and where the first of
+// them sits. Once built it is kept up to date on every add and remove, so both lookups
+// are O(1).
+class InventoryIndex {
+public:
+    struct Entry {
+        size_t count = 0;
+        size_t first = 0;
+    };
+
+private:
+    std::unordered_map<std::string, Entry> byName;
+    std::array<Entry, kItemTypes> byType{};
+
+    static void added(Entry& entry, size_t position) {
+        if (entry.count++ == 0) {
+            entry.first = position;
+        }
+    }
+
+    template<typename Matches>
+    static void removed(Entry& entry, size_t position, const Item* items, Matches matches) {
+        if (--entry.count > 0 && entry.first == position) {
+            while (!matches(items[entry.first])) {
+                entry.first++;
+            }
+        }
+    }
+
+public:
+    void add(const Item& item, size_t position) {
+        added(byName[item.name], position);
+        added(byType[static_cast<size_t>(item.type)], position);
+    }
+
+    // Called once item has left position and the items after it moved down by one.
+    void remove(const Item& item, size_t position, const Item* items) {
+        for (auto& [name, entry] : byName) {
+            if (entry.first > position) {
+                entry.first--;
+            }
+        }
+        for (Entry& entry : byType) {
+            if (entry.count > 0 && entry.first > position) {
+                entry.first--;
+            }
+        }
+        auto nameEntry = byName.find(item.name);
+        removed(nameEntry->second, position, items, [&](const Item& other) { return other.name == item.name; });
+        if (nameEntry->second.count == 0) {
+            byName.erase(nameEntry);
+        }
+        removed(byType[static_cast<size_t>(item.type)], position, items,
+            [&](const Item& other) { return other.type == item.type; });
+    }
+
+    void clear() {
+        byName.clear();
+        byType.fill(Entry());
+    }
+
+    const Entry* find(const std::string& name) const {
+        auto it = byName.find(name);
+        return it == byName.end() ? nullptr : &it->second;
+    }
+
+    const Entry& find(ItemType type) const { return byType[static_cast<size_t>(type)]; }
+};
+
+// Inventory of items. The first InlineCapacity items live inside the object, so adding
+// to a small inventory allocates nothing beyond the item's own name; beyond that it
+// grows into raw storage from Allocator and moves the items over, without
+// default-constructing spare slots. Counts and first positions by name and by type come
+// from an InventoryIndex, which is built on the first lookup, since its map allocates
+// per name and most inventories are only ever added to and listed.
+template<size_t InlineCapacity = 5, typename Allocator = std::allocator<Item>>
+class BasicInventory {
+private:
+    static_assert(InlineCapacity > 0, "BasicInventory needs at least one inline slot");
+    using Traits = std::allocator_traits<Allocator>;
+
+    [[no_unique_address]] Allocator allocator;
+    alignas(Item) unsigned char buffer[InlineCapacity * sizeof(Item)];
+    Item* items;
+    size_t capacity;
+    size_t currentSize;
+    mutable InventoryIndex index;
+    mutable bool indexed = false;
+
+    Item* inlineItems() { return reinterpret_cast<Item*>(buffer); }
+    bool isInline() const { return items == reinterpret_cast<const Item*>(buffer); }
+
+    void destroyItems() {
+        for (size_t i = 0; i < currentSize; i++) {
+            Traits::destroy(allocator, items + i);
+        }
+        currentSize = 0;
+        index.clear();
+        indexed = false;
+    }
+
+    void releaseStorage() {
+        destroyItems();
+        if (!isInline()) {
+            Traits::deallocate(allocator, items, capacity);
+        }
+        items = inlineItems();
+        capacity = InlineCapacity;
+    }
+
+    // Moves the current items into newItems, which already holds any new element.
+    void adopt(Item* newItems, size_t newCapacity) {
+        for (size_t i = 0; i < currentSize; i++) {
+            Traits::construct(allocator, newItems + i, std::move(items[i]));
+            Traits::destroy(allocator, items + i);
+        }
+        if (!isInline()) {
+            Traits::deallocate(allocator, items, capacity);
+        }
+        items = newItems;
+        capacity = newCapacity;
+    }
+
+    const InventoryIndex& lookup() const {
+        if (!indexed) {
+            for (size_t i = 0; i < currentSize; i++) {
+                index.add(items[i], i);
+            }
+            indexed = true;
+        }
+        return index;
+    }
+
+    void reserveExact(size_t newCapacity) {
+        if (newCapacity > capacity) {
+            adopt(Traits::allocate(allocator, newCapacity), newCapacity);
+        }
+    }
+
+    // Takes other's items: steals its heap block if it has one, else moves them one by one.
+    void takeFrom(BasicInventory& other) {
+        if (!other.isInline() && allocator == other.allocator) {
+            items = other.items;
+            capacity = other.capacity;
+            currentSize = other.currentSize;
+            index = std::move(other.index);
+            indexed = other.indexed;
+            other.items = other.inlineItems();
+            other.capacity = InlineCapacity;
+            other.currentSize = 0;
+            other.index.clear();
+            other.indexed = false;
+            return;
+        }
+        reserveExact(other.currentSize);
+        for (size_t i = 0; i < other.currentSize; i++) {
+            Traits::construct(allocator, items + i, std::move(other.items[i]));
+        }
+        currentSize = other.currentSize;
+        index = std::move(other.index);
+        indexed = other.indexed;
+        other.releaseStorage();
+    }
+
+public:
+    explicit BasicInventory(size_t initialCapacity = InlineCapacity, const Allocator& alloc = Allocator())
+        : allocator(alloc), items(inlineItems()), capacity(InlineCapacity), currentSize(0) {
+        reserveExact(initialCapacity);
+    }
+
+    BasicInventory(const BasicInventory& other)
+        : BasicInventory(other.currentSize, Traits::select_on_container_copy_construction(other.allocator)) {
+        for (size_t i = 0; i < other.currentSize; i++) {
+            Traits::construct(allocator, items + i, other.items[i]);
+            currentSize++;
+        }
+        index = other.index;
+        indexed = other.indexed;
+    }
+
+    BasicInventory(BasicInventory&& other) noexcept
+        : allocator(std::move(other.allocator)), items(inlineItems()), capacity(InlineCapacity), currentSize(0) {
+        takeFrom(other);
+    }
+
+    // Keeps the current storage when it is big enough; the allocator follows other only
+    // if the allocator asks for that on copy assignment.
+    BasicInventory& operator=(const BasicInventory& other) {
+        if (this != &other) {
+            destroyItems();
+            if constexpr (Traits::propagate_on_container_copy_assignment::value) {
+                if (allocator != other.allocator) {
+                    releaseStorage();
+                }
+                allocator = other.allocator;
+            }
+            reserveExact(other.currentSize);
+            for (size_t i = 0; i < other.currentSize; i++) {
+                Traits::construct(allocator, items + i, other.items[i]);
+                currentSize++;
+            }
+            index = other.index;
+            indexed = other.indexed;
+        }
+        return *this;
+    }
+
+    BasicInventory& operator=(BasicInventory&& other)
+        noexcept(Traits::propagate_on_container_move_assignment::value || Traits::is_always_equal::value) {
+        if (this != &other) {
+            releaseStorage();
+            if constexpr (Traits::propagate_on_container_move_assignment::value) {
+                allocator = std::move(other.allocator);
+            }
+            takeFrom(other);
+        }
+        return *this;
+    }
+
+    ~BasicInventory() {
+        releaseStorage();
+    }
+
+    template<typename... Args>
+    Item& emplaceItem(Args&&... args) {
+        if (currentSize < capacity) {
+            Traits::construct(allocator, items + currentSize, std::forward<Args>(args)...);
+        }
+        else {
+            // Build the new item first: args may refer to an item that is about to move.
+            size_t newCapacity = capacity * 2;
+            Item* newItems = Traits::allocate(allocator, newCapacity);
+            try {
+                Traits::construct(allocator, newItems + currentSize, std::forward<Args>(args)...);
+            }
+            catch (...) {
+                Traits::deallocate(allocator, newItems, newCapacity);
+                throw;
+            }
+            adopt(newItems, newCapacity);
+        }
+        if (indexed) {
+            index.add(items[currentSize], currentSize);
+        }
+        return items[currentSize++];
+    }
+
+    void addItem(const std::string& name, ItemType type = ItemType::Misc) { emplaceItem(name, type); }
+    void addItem(std::string&& name, ItemType type = ItemType::Misc) { emplaceItem(std::move(name), type); }
+
+    // Removes the item at position and shifts the rest down; false if out of range.
+    bool removeItem(size_t position) {
+        if (position >= currentSize) {
+            return false;
+        }
+        Item removed = std::move(items[position]);
+        for (size_t i = position + 1; i < currentSize; i++) {
+            items[i - 1] = std::move(items[i]);
+        }
+        Traits::destroy(allocator, items + --currentSize);
+        if (indexed) {
+            index.remove(removed, position, items);
+        }
+        return true;
+    }
+
+    size_t count(const std::string& name) const {
+        const InventoryIndex::Entry* entry = lookup().find(name);
+        return entry ? entry->count : 0;
+    }
+
+    size_t count(ItemType type) const { return lookup().find(type).count; }
+
+    // Position of the first item with this name or type, if any.
+    std::optional<size_t> firstOf(const std::string& name) const {
+        const InventoryIndex::Entry* entry = lookup().find(name);
+        return entry ? std::optional<size_t>(entry->first) : std::nullopt;
+    }
+
+    std::optional<size_t> firstOf(ItemType type) const {
+        const InventoryIndex::Entry& entry = lookup().find(type);
+        return entry.count > 0 ? std::optional<size_t>(entry.first) : std::nullopt;
+    }
+
+    size_t size() const { return currentSize; }
+    const Item& operator[](size_t position) const { return items[position]; }
+
+    void displayInventory() const {
+        if (currentSize == 0) {
+            std::cout << "Inventory is empty\n";
+            return;
+        }
+        std::cout << "Inventory contents:\n";
+        for (size_t i = 0; i < currentSize; i++) {
+            std::cout << i + 1 << ". " << items[i].name << "\n";
+        }
+    }
+};
+
+using Inventory = BasicInventory<>;
+
+// Every player's inventory packed into shared columns. Player p owns rows
+// offsets[p]..offsets[p + 1] of itemIds and counts; item names are interned once, and
+// duplicate items of a player are folded into one row with a count.
+class InventoryStore {
+private:
+    std::vector<std::string> names; // by item id
+    std::vector<ItemType> types;    // by item id
+    std::unordered_map<std::string, uint32_t> idsByName;
+    std::vector<uint64_t> offsets{ 0 };
+    std::vector<uint32_t> itemIds;
+    std::vector<uint32_t> counts;
+
+    static void writeVarint(std::ostream& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.put(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        out.put(static_cast<char>(value));
+    }
+
+    static uint64_t readVarint(std::istream& in) {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            int byte = in.get();
+            if (byte == EOF) {
+                throw std::runtime_error("Truncated inventory store");
+            }
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        return value;
+    }
+
+public:
+    // Read-only view of one player's rows. displayInventory prints in the format of
+    // Inventory::displayInventory, one line per item; since duplicates were folded into
+    // one row, they come out next to each other rather than where they were added.
+    class PlayerView {
+    private:
+        const InventoryStore* store;
+        uint64_t begin;
+        uint64_t end;
+
+    public:
+        PlayerView(const InventoryStore& s, size_t player)
+            : store(&s), begin(s.offsets[player]), end(s.offsets[player + 1]) {}
+
+        size_t size() const { return static_cast<size_t>(end - begin); }
+        const std::string& name(size_t row) const { return store->names[store->itemIds[begin + row]]; }
+        ItemType type(size_t row) const { return store->types[store->itemIds[begin + row]]; }
+        uint32_t count(size_t row) const { return store->counts[begin + row]; }
+
+        void displayInventory() const {
+            if (size() == 0) {
+                std::cout << "Inventory is empty\n";
+                return;
+            }
+            std::cout << "Inventory contents:\n";
+            size_t number = 1;
+            for (size_t i = 0; i < size(); i++) {
+                for (uint32_t copy = 0; copy < count(i); copy++) {
+                    std::cout << number++ << ". " << name(i) << "\n";
+                }
+            }
+        }
+    };
+
+    uint32_t intern(const std::string& name, ItemType type = ItemType::Misc) {
+        auto [it, inserted] = idsByName.emplace(name, static_cast<uint32_t>(names.size()));
+        if (inserted) {
+            names.push_back(name);
+            types.push_back(type);
+        }
+        return it->second;
+    }
+
+    std::optional<uint32_t> find(const std::string& name) const {
+        auto it = idsByName.find(name);
+        return it == idsByName.end() ? std::nullopt : std::optional<uint32_t>(it->second);
+    }
+
+    // Appends a player with the items of inventory; returns the player's index.
+    template<size_t N, typename A>
+    size_t addPlayer(const BasicInventory<N, A>& inventory) {
+        uint64_t first = itemIds.size();
+        for (size_t i = 0; i < inventory.size(); i++) {
+            uint32_t id = intern(inventory[i].name, inventory[i].type);
+            auto row = std::find(itemIds.begin() + first, itemIds.end(), id);
+            if (row != itemIds.end()) {
+                counts[row - itemIds.begin()]++;
+            }
+            else {
+                itemIds.push_back(id);
+                counts.push_back(1);
+            }
+        }
+        offsets.push_back(itemIds.size());
+        return offsets.size() - 2;
+    }
+
+    // Appends a player from (item id, count) rows with distinct ids.
+    size_t addPlayer(const std::vector<std::pair<uint32_t, uint32_t>>& rows) {
+        for (const auto& [id, count] : rows) {
+            itemIds.push_back(id);
+            counts.push_back(count);
+        }
+        offsets.push_back(itemIds.size());
+        return offsets.size() - 2;
+    }
+
+    size_t players() const { return offsets.size() - 1; }
+    size_t rows() const { return itemIds.size(); }
+    PlayerView player(size_t index) const { return PlayerView(*this, index); }
+
+    size_t bytesUsed() const {
+        size_t bytes = offsets.capacity() * sizeof(uint64_t) + itemIds.capacity() * sizeof(uint32_t)
+            + counts.capacity() * sizeof(uint32_t);
+        for (const std::string& name : names) {
+            bytes += sizeof(std::string) + name.capacity();
+        }
+        return bytes;
+    }
+
+    // Number of players for which rowMatches(itemId, count) holds on at least one row,
+    // scanned by threads workers over disjoint player ranges.
+    template<typename RowPredicate>
+    size_t countPlayers(RowPredicate rowMatches, unsigned threads) const {
+        threads = std::max(threads, 1u);
+        std::vector<size_t> partial(threads, 0);
+        std::vector<std::thread> workers;
+        size_t total = players();
+        for (unsigned t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                size_t found = 0;
+                for (size_t p = total * t / threads; p < total * (t + 1) / threads; p++) {
+                    for (uint64_t row = offsets[p]; row < offsets[p + 1]; row++) {
+                        if (rowMatches(itemIds[row], counts[row])) {
+                            found++;
+                            break;
+                        }
+                    }
+                }
+                partial[t] = found;
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        return std::accumulate(partial.begin(), partial.end(), size_t(0));
+    }
+
+    size_t countPlayersOwning(const std::string& name, unsigned threads) const {
+        std::optional<uint32_t> id = find(name);
+        if (!id) {
+            return 0;
+        }
+        return countPlayers([id = *id](uint32_t item, uint32_t) { return item == id; }, threads);
+    }
+
+    // Names, then per player the row count and (id, count) rows, all as varints.
+    void save(std::ostream& out) const {
+        writeVarint(out, names.size());
+        for (size_t id = 0; id < names.size(); id++) {
+            writeVarint(out, names[id].size());
+            out.write(names[id].data(), static_cast<std::streamsize>(names[id].size()));
+            writeVarint(out, static_cast<uint64_t>(types[id]));
+        }
+        writeVarint(out, players());
+        for (size_t p = 0; p < players(); p++) {
+            writeVarint(out, offsets[p + 1] - offsets[p]);
+            for (uint64_t row = offsets[p]; row < offsets[p + 1]; row++) {
+                writeVarint(out, itemIds[row]);
+                writeVarint(out, counts[row]);
+            }
+        }
+    }
+
+    static InventoryStore load(std::istream& in) {
+        InventoryStore store;
+        auto corrupt = [] { return std::runtime_error("Corrupt inventory store"); };
+        uint64_t nameCount = readVarint(in);
+        for (uint64_t id = 0; id < nameCount; id++) {
+            std::string name(readVarint(in), '\0');
+            if (!in.read(name.data(), static_cast<std::streamsize>(name.size()))) {
+                throw corrupt();
+            }
+            uint64_t type = readVarint(in);
+            if (type >= kItemTypes || store.intern(name, static_cast<ItemType>(type)) != id) {
+                throw corrupt();
+            }
+        }
+        uint64_t playerCount = readVarint(in);
+        for (uint64_t p = 0; p < playerCount; p++) {
+            uint64_t rowCount = readVarint(in);
+            for (uint64_t row = 0; row < rowCount; row++) {
+                uint64_t id = readVarint(in);
+                uint64_t count = readVarint(in);
+                if (id >= nameCount || count > UINT32_MAX) {
+                    throw corrupt();
+                }
+                store.itemIds.push_back(static_cast<uint32_t>(id));
+                store.counts.push_back(static_cast<uint32_t>(count));
+            }
+            store.offsets.push_back(store.itemIds.size());
+        }
+        return store;
+    }
+
+    bool operator==(const InventoryStore& other) const {
+        return names == other.names && types == other.types && offsets == other.offsets
+            && itemIds == other.itemIds && counts == other.counts;
+    }
+};
+
+// The previous Inventory, kept as the baseline for "4_0 bench".
+class LegacyInventory {
 private:
     std::string* items;
     size_t capacity;
     size_t currentSize;
 
 public:
-    Inventory(size_t initialCapacity = 5): 
+    LegacyInventory(size_t initialCapacity = 5):
         capacity(initialCapacity), currentSize(0) {
         items = new std::string[capacity];
     }
@@ -33,42 +575,121 @@ public:
             capacity = newCapacity;
         }
     }
-    void displayInventory() const {
-        if (currentSize == 0) {
-            std::cout << "Inventory is empty\n";
-            return;
+
+    ~LegacyInventory() {
+        delete[] items;
+    }
+};
+
+// "4_0 bench [items]": fills many three-item inventories and one large inventory with
+// the same names, old class against new.
+template<typename T>
+double nanosecondsPerItem(size_t inventories, size_t itemsEach, const std::vector<std::string>& names) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < inventories; i++) {
+        T inventory(2);
+        for (size_t j = 0; j < itemsEach; j++) {
+            inventory.addItem(std::string(names[j % names.size()]));
         }
-        std::cout << "Inventory contents:\n";
-        for (size_t i = 0; i < currentSize; i++) {
-            std::cout << i + 1 << ". " << items[i] << "\n";
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (inventories * itemsEach);
+}
+
+int runBenchmark(size_t items) {
+    const std::vector<std::string> names = { "Potion", "Invisibility potion of the night", "Sword of a thousand truths" };
+    std::cout << "ns per item          LegacyInventory  Inventory\n";
+    std::cout << "3-item inventories   " << nanosecondsPerItem<LegacyInventory>(items / 3, 3, names)
+        << "  " << nanosecondsPerItem<Inventory>(items / 3, 3, names) << "\n";
+    std::cout << items << "-item inventory  " << nanosecondsPerItem<LegacyInventory>(1, items, names)
+        << "  " << nanosecondsPerItem<Inventory>(1, items, names) << "\n";
+    return 0;
+}
+
+// "4_0 store [players] [threads]": builds random players in an InventoryStore, counts
+// Bow owners with 1..threads scan workers and round-trips the store through save/load.
+int runStoreDemo(size_t playerCount, unsigned maxThreads) {
+    if (playerCount == 0) {
+        std::cerr << "Usage: 4_0 store [players >= 1] [threads]\n";
+        return 1;
+    }
+    const std::vector<std::pair<std::string, ItemType>> kinds = {
+        { "Potion", ItemType::Consumable }, { "Sword", ItemType::Weapon }, { "Bow", ItemType::Weapon },
+        { "Arrows", ItemType::Ammo }, { "Knife", ItemType::Weapon }, { "Invisibility poiton", ItemType::Consumable },
+        { "Sgield", ItemType::Armor }, { "Helmet", ItemType::Armor }, { "Axe", ItemType::Weapon }
+    };
+    InventoryStore store;
+    std::vector<uint32_t> ids;
+    for (const auto& [name, type] : kinds) {
+        ids.push_back(store.intern(name, type));
+    }
+    std::mt19937 random(1);
+    std::vector<std::pair<uint32_t, uint32_t>> rows;
+    for (size_t p = 0; p < playerCount; p++) {
+        rows.clear();
+        for (uint32_t id : ids) {
+            if (random() % 3 == 0) {
+                rows.emplace_back(id, 1 + random() % 20);
+            }
         }
+        store.addPlayer(rows);
     }
+    std::cout << store.players() << " players, " << store.rows() << " rows, "
+        << static_cast<double>(store.bytesUsed()) / store.players() << " bytes per player\n";
 
-    ~Inventory() {
-        delete[] items;
+    for (unsigned threads = 1; threads <= maxThreads; threads++) {
+        auto start = std::chrono::steady_clock::now();
+        size_t owners = store.countPlayersOwning("Bow", threads);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << threads << " threads: " << owners << " players own a Bow (" << elapsed.count() << " ms)\n";
     }
-};
-int main() {
+
+    std::stringstream buffer;
+    store.save(buffer);
+    size_t savedBytes = buffer.str().size();
+    InventoryStore loaded = InventoryStore::load(buffer);
+    bool reloadMatches = loaded == store;
+    std::cout << "Saved in " << savedBytes << " bytes (" << static_cast<double>(savedBytes) / store.players()
+        << " per player), reload " << (reloadMatches ? "matches" : "DIFFERS") << "\n\n";
+
+    Inventory inventory;
+    inventory.addItem("Bow", ItemType::Weapon);
+    inventory.addItem("Arrows", ItemType::Ammo);
+    inventory.addItem("Arrows", ItemType::Ammo);
+    inventory.displayInventory();
+    store.player(store.addPlayer(inventory)).displayInventory();
+    return reloadMatches ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "bench") {
+        return runBenchmark(argc > 2 ? std::stoul(argv[2]) : 3000000);
+    }
+    if (argc > 1 && std::string(argv[1]) == "store") {
+        unsigned threads = argc > 3 ? std::stoul(argv[3]) : std::max(std::thread::hardware_concurrency(), 1u);
+        return runStoreDemo(argc > 2 ? std::stoul(argv[2]) : 1000000, threads);
+    }
+
     std::unique_ptr<Inventory>  inventories[] = {
         std::make_unique<Inventory>(4),
         std::make_unique<Inventory>(2),
         std::make_unique<Inventory>(3)
     };
-    inventories[0]->addItem("Potion");
-    inventories[0]->addItem("Sword");
-    inventories[0]->addItem("Bow");
-    inventories[0]->addItem("Arrows");
+    inventories[0]->addItem("Potion", ItemType::Consumable);
+    inventories[0]->addItem("Sword", ItemType::Weapon);
+    inventories[0]->addItem("Bow", ItemType::Weapon);
+    inventories[0]->addItem("Arrows", ItemType::Ammo);
 
 
-    inventories[1]->addItem("Knife");
-    inventories[1]->addItem("Invisibility poiton");
+    inventories[1]->addItem("Knife", ItemType::Weapon);
+    inventories[1]->addItem("Invisibility poiton", ItemType::Consumable);
 
-    inventories[2]->addItem("Sgield");
-    inventories[2]->addItem("Helmet");
-    inventories[2]->addItem("Axe");
+    inventories[2]->addItem("Sgield", ItemType::Armor);
+    inventories[2]->addItem("Helmet", ItemType::Armor);
+    inventories[2]->addItem("Axe", ItemType::Weapon);
     for (const auto& inventori : inventories) {
         inventori->displayInventory();
-        std::cout << "\n";
+        std::cout << "Weapons: " << inventori->count(ItemType::Weapon) << "\n\n";
     }
     return 0;
 }
\ No newline at end of file
@@ -1,41 +1,302 @@
 ﻿#include <iostream>
 #include <vector>
 #include <string>
+#include <memory>
+#include <optional>
+#include <iterator>
+#include <algorithm>
+#include <utility>
+#include <type_traits>
+#include <stdexcept>
+#include <chrono>
 
+// FIFO queue on a growable ring buffer: push and pop are O(1) amortized, so draining n
+// items costs O(n). The capacity is a power of two and only the live range
+// [head, head + count) holds constructed elements, so T needs no default constructor.
 template <typename T>
 class Queue
 {
 private:
-    std::vector<T> items;
+    T* items = nullptr;
+    size_t capacity = 0;
+    size_t head = 0;
+    size_t count = 0;
+
+    T* slot(size_t index) const
+    {
+        return items + ((head + index) & (capacity - 1));
+    }
+
+    static T* allocate(size_t n)
+    {
+        return std::allocator<T>().allocate(n);
+    }
+
+    void release()
+    {
+        clear();
+        if (items != nullptr) {
+            std::allocator<T>().deallocate(items, capacity);
+        }
+        items = nullptr;
+        capacity = 0;
+    }
+
+    // Moves the live elements to the front of newItems, which may already hold the
+    // element being pushed at index count.
+    void adopt(T* newItems, size_t newCapacity)
+    {
+        for (size_t i = 0; i < count; i++) {
+            std::construct_at(newItems + i, std::move(*slot(i)));
+            std::destroy_at(slot(i));
+        }
+        if (items != nullptr) {
+            std::allocator<T>().deallocate(items, capacity);
+        }
+        items = newItems;
+        capacity = newCapacity;
+        head = 0;
+    }
+
+    static size_t roundUp(size_t n)
+    {
+        size_t rounded = 8;
+        while (rounded < n) {
+            rounded *= 2;
+        }
+        return rounded;
+    }
 
 public:
-    void push(const T& item)
+    Queue() = default;
+
+    Queue(const Queue& other)
     {
-        items.push_back(item);
+        try {
+            reserve(other.count);
+            for (size_t i = 0; i < other.count; i++) {
+                push(*other.slot(i));
+            }
+        }
+        catch (...) {
+            release();
+            throw;
+        }
     }
 
-    void pop()
+    Queue(Queue&& other) noexcept
+        : items(std::exchange(other.items, nullptr)), capacity(std::exchange(other.capacity, 0)),
+        head(std::exchange(other.head, 0)), count(std::exchange(other.count, 0))
     {
-        if (!items.empty()) {
-            items.erase(items.begin());
+    }
+
+    Queue& operator=(Queue other) noexcept
+    {
+        std::swap(items, other.items);
+        std::swap(capacity, other.capacity);
+        std::swap(head, other.head);
+        std::swap(count, other.count);
+        return *this;
+    }
+
+    ~Queue()
+    {
+        release();
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    void reserve(size_t n)
+    {
+        if (n > capacity) {
+            size_t newCapacity = roundUp(n);
+            adopt(allocate(newCapacity), newCapacity);
+        }
+    }
+
+    void clear()
+    {
+        for (size_t i = 0; i < count; i++) {
+            std::destroy_at(slot(i));
+        }
+        head = 0;
+        count = 0;
+    }
+
+    template <typename... Args>
+    T& emplace(Args&&... args)
+    {
+        if (count < capacity) {
+            std::construct_at(slot(count), std::forward<Args>(args)...);
         }
         else {
+            // Build the new item first: args may refer to an item that is about to move.
+            size_t newCapacity = roundUp(capacity * 2);
+            T* newItems = allocate(newCapacity);
+            try {
+                std::construct_at(newItems + count, std::forward<Args>(args)...);
+            }
+            catch (...) {
+                std::allocator<T>().deallocate(newItems, newCapacity);
+                throw;
+            }
+            adopt(newItems, newCapacity);
+        }
+        return *slot(count++);
+    }
+
+    void push(const T& item)
+    {
+        emplace(item);
+    }
+
+    void push(T&& item)
+    {
+        emplace(std::move(item));
+    }
+
+    template <typename InputIt>
+    void push_range(InputIt first, InputIt last)
+    {
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category>) {
+            reserve(count + static_cast<size_t>(std::distance(first, last)));
+        }
+        for (; first != last; ++first) {
+            emplace(*first);
+        }
+    }
+
+    template <typename Range>
+    void push_range(Range&& range)
+    {
+        push_range(std::begin(range), std::end(range));
+    }
+
+    T& front()
+    {
+        if (count == 0) {
+            throw std::out_of_range("Queue is empty");
+        }
+        return *slot(0);
+    }
+
+    const T& front() const
+    {
+        if (count == 0) {
+            throw std::out_of_range("Queue is empty");
+        }
+        return *slot(0);
+    }
+
+    void pop()
+    {
+        if (count == 0) {
             std::cout << "Queue is empty. Nothing to pop.\n";
+            return;
+        }
+        std::destroy_at(slot(0));
+        head = (head + 1) & (capacity - 1);
+        count--;
+    }
+
+    std::optional<T> try_pop()
+    {
+        if (count == 0) {
+            return std::nullopt;
         }
+        std::optional<T> item(std::move(*slot(0)));
+        std::destroy_at(slot(0));
+        head = (head + 1) & (capacity - 1);
+        count--;
+        return item;
+    }
+
+    // Moves up to n items from the front to out; returns how many were moved.
+    template <typename OutputIt>
+    size_t pop_n(size_t n, OutputIt out)
+    {
+        n = std::min(n, count);
+        for (size_t i = 0; i < n; i++) {
+            *out++ = std::move(*slot(i));
+            std::destroy_at(slot(i));
+        }
+        head = (head + n) & (capacity - 1);
+        count -= n;
+        return n;
     }
 
     void displayInfo() const
     {
-        for (const auto& item : items)
+        for (size_t i = 0; i < count; i++)
         {
-            std::cout << item << " ";
+            std::cout << *slot(i) << " ";
         }
         std::cout << std::endl;
     }
 };
 
-int main()
+// The previous Queue, kept as the baseline for "5_0 bench".
+template <typename T>
+class LegacyQueue
 {
+private:
+    std::vector<T> items;
+
+public:
+    void push(const T& item)
+    {
+        items.push_back(item);
+    }
+
+    void pop()
+    {
+        items.erase(items.begin());
+    }
+};
+
+// Time to fill a queue with n items and pop them all, in ns per item.
+template <typename Q>
+double drainNanosecondsPerItem(size_t n)
+{
+    auto start = std::chrono::steady_clock::now();
+    Q queue;
+    for (size_t i = 0; i < n; i++) {
+        queue.push(static_cast<int>(i));
+    }
+    for (size_t i = 0; i < n; i++) {
+        queue.pop();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / n;
+}
+
+// "5_0 bench [items]": drains queues of doubling size up to items. A flat ns-per-item
+// column means linear time; the vector baseline grows with n and is skipped past 64k.
+int runBenchmark(size_t items)
+{
+    constexpr size_t kLegacyLimit = 65536;
+    std::cout << "items      Queue ns/item  LegacyQueue ns/item\n";
+    for (size_t n = std::max<size_t>(items / 64, 1); n <= items; n *= 2)
+    {
+        std::cout << n << "  " << drainNanosecondsPerItem<Queue<int>>(n) << "  ";
+        if (n <= kLegacyLimit) {
+            std::cout << drainNanosecondsPerItem<LegacyQueue<int>>(n);
+        }
+        else {
+            std::cout << "-";
+        }
+        std::cout << "\n";
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && std::string(argv[1]) == "bench") {
+        return runBenchmark(argc > 2 ? std::stoul(argv[2]) : 1000000);
+    }
+
     std::cout << "Queue with strings:\n";
     Queue<std::string> stringQueue;
     stringQueue.push("Sword");
@@ -1,39 +1,1221 @@
 ﻿#include <iostream>
 #include <vector>
 #include <string>
+#include <memory>
+#include <optional>
+#include <iterator>
+#include <algorithm>
+#include <utility>
+#include <type_traits>
+#include <stdexcept>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <array>
+#include <functional>
+#include <queue>
+#include <random>
 
-template <typename T>
+// Concurrency policies for Queue. SingleThreaded is the growable queue below; Spsc and
+// Mpmc are bounded, lock-free variants for one or many producers and consumers, and
+// Blocking is a bounded Mpmc whose callers wait instead of failing.
+struct SingleThreaded {};
+struct Spsc {};
+struct Mpmc {};
+struct Blocking {};
+
+// Producer and consumer cursors are kept this far apart so they never share a cache line.
+constexpr size_t kCacheLine = 64;
+
+// FIFO queue on a growable ring buffer: push and pop are O(1) amortized, so draining n
+// items costs O(n). The capacity is a power of two and only the live range
+// [head, head + count) holds constructed elements, so T needs no default constructor.
+template <typename T, typename Policy = SingleThreaded>
 class Queue
 {
 private:
-    std::vector<T> items;
+    T* items = nullptr;
+    size_t capacity = 0;
+    size_t head = 0;
+    size_t count = 0;
+
+    T* slot(size_t index) const
+    {
+        return items + ((head + index) & (capacity - 1));
+    }
+
+    static T* allocate(size_t n)
+    {
+        return std::allocator<T>().allocate(n);
+    }
+
+    void release()
+    {
+        clear();
+        if (items != nullptr) {
+            std::allocator<T>().deallocate(items, capacity);
+        }
+        items = nullptr;
+        capacity = 0;
+    }
+
+    // Moves the live elements to the front of newItems, which may already hold the
+    // element being pushed at index count.
+    void adopt(T* newItems, size_t newCapacity)
+    {
+        for (size_t i = 0; i < count; i++) {
+            std::construct_at(newItems + i, std::move(*slot(i)));
+            std::destroy_at(slot(i));
+        }
+        if (items != nullptr) {
+            std::allocator<T>().deallocate(items, capacity);
+        }
+        items = newItems;
+        capacity = newCapacity;
+        head = 0;
+    }
+
+    static size_t roundUp(size_t n)
+    {
+        size_t rounded = 8;
+        while (rounded < n) {
+            rounded *= 2;
+        }
+        return rounded;
+    }
 
 public:
+    Queue() = default;
+
+    Queue(const Queue& other)
+    {
+        try {
+            reserve(other.count);
+            for (size_t i = 0; i < other.count; i++) {
+                push(*other.slot(i));
+            }
+        }
+        catch (...) {
+            release();
+            throw;
+        }
+    }
+
+    Queue(Queue&& other) noexcept
+        : items(std::exchange(other.items, nullptr)), capacity(std::exchange(other.capacity, 0)),
+        head(std::exchange(other.head, 0)), count(std::exchange(other.count, 0))
+    {
+    }
+
+    Queue& operator=(Queue other) noexcept
+    {
+        std::swap(items, other.items);
+        std::swap(capacity, other.capacity);
+        std::swap(head, other.head);
+        std::swap(count, other.count);
+        return *this;
+    }
+
+    ~Queue()
+    {
+        release();
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    void reserve(size_t n)
+    {
+        if (n > capacity) {
+            size_t newCapacity = roundUp(n);
+            adopt(allocate(newCapacity), newCapacity);
+        }
+    }
+
+    void clear()
+    {
+        for (size_t i = 0; i < count; i++) {
+            std::destroy_at(slot(i));
+        }
+        head = 0;
+        count = 0;
+    }
+
+    template <typename... Args>
+    T& emplace(Args&&... args)
+    {
+        if (count < capacity) {
+            std::construct_at(slot(count), std::forward<Args>(args)...);
+        }
+        else {
+            // Build the new item first: args may refer to an item that is about to move.
+            size_t newCapacity = roundUp(capacity * 2);
+            T* newItems = allocate(newCapacity);
+            try {
+                std::construct_at(newItems + count, std::forward<Args>(args)...);
+            }
+            catch (...) {
+                std::allocator<T>().deallocate(newItems, newCapacity);
+                throw;
+            }
+            adopt(newItems, newCapacity);
+        }
+        return *slot(count++);
+    }
+
     void push(const T& item)
     {
-        items.push_back(item);
+        emplace(item);
+    }
+
+    void push(T&& item)
+    {
+        emplace(std::move(item));
+    }
+
+    template <typename InputIt>
+    void push_range(InputIt first, InputIt last)
+    {
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category>) {
+            reserve(count + static_cast<size_t>(std::distance(first, last)));
+        }
+        for (; first != last; ++first) {
+            emplace(*first);
+        }
+    }
+
+    template <typename Range>
+    void push_range(Range&& range)
+    {
+        push_range(std::begin(range), std::end(range));
+    }
+
+    T& front()
+    {
+        if (count == 0) {
+            throw std::invalid_argument("Queue is empty");
+        }
+        return *slot(0);
+    }
+
+    const T& front() const
+    {
+        if (count == 0) {
+            throw std::invalid_argument("Queue is empty");
+        }
+        return *slot(0);
     }
 
     void pop()
     {
-        if (items.empty()) {
+        if (count == 0) {
             throw std::invalid_argument("Queue is empty");
         }
-        items.erase(items.begin());
+        std::destroy_at(slot(0));
+        head = (head + 1) & (capacity - 1);
+        count--;
+    }
+
+    std::optional<T> try_pop()
+    {
+        if (count == 0) {
+            return std::nullopt;
+        }
+        std::optional<T> item(std::move(*slot(0)));
+        std::destroy_at(slot(0));
+        head = (head + 1) & (capacity - 1);
+        count--;
+        return item;
+    }
+
+    // Moves up to n items from the front to out; returns how many were moved.
+    template <typename OutputIt>
+    size_t pop_n(size_t n, OutputIt out)
+    {
+        n = std::min(n, count);
+        for (size_t i = 0; i < n; i++) {
+            *out++ = std::move(*slot(i));
+            std::destroy_at(slot(i));
+        }
+        head = (head + n) & (capacity - 1);
+        count -= n;
+        return n;
     }
 
     void displayInfo() const
     {
-        for (const auto& item : items)
+        for (size_t i = 0; i < count; i++)
         {
-            std::cout << item << " ";
+            std::cout << *slot(i) << " ";
         }
         std::cout << std::endl;
     }
 };
 
-int main()
+// Bounded queue for exactly one producer thread and one consumer thread. Each side
+// owns its cursor and keeps a cached copy of the other one, re-reading the shared
+// cursor only when the cached copy says the ring is full (or empty), so try_push and
+// try_pop finish in a bounded number of steps.
+template <typename T>
+class Queue<T, Spsc>
+{
+private:
+    struct Slot
+    {
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* value() { return reinterpret_cast<T*>(storage); }
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    alignas(kCacheLine) std::atomic<size_t> tail{ 0 }; // written by the producer
+    size_t cachedHead = 0;
+    alignas(kCacheLine) std::atomic<size_t> head{ 0 }; // written by the consumer
+    size_t cachedTail = 0;
+
+public:
+    // Capacity is rounded up to a power of two.
+    explicit Queue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        slots.reset(new Slot[size]);
+        mask = size - 1;
+    }
+
+    Queue(const Queue&) = delete;
+    Queue& operator=(const Queue&) = delete;
+
+    ~Queue()
+    {
+        for (size_t pos = head.load(); pos != tail.load(); pos++) {
+            std::destroy_at(slots[pos & mask].value());
+        }
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+    // Producer only. False if the queue is full; args are left untouched then.
+    template <typename... Args>
+    bool try_emplace(Args&&... args)
+    {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        if (pos - cachedHead > mask) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (pos - cachedHead > mask) {
+                return false;
+            }
+        }
+        std::construct_at(slots[pos & mask].value(), std::forward<Args>(args)...);
+        tail.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_push(const T& item) { return try_emplace(item); }
+    bool try_push(T&& item) { return try_emplace(std::move(item)); }
+
+    // Consumer only.
+    std::optional<T> try_pop()
+    {
+        size_t pos = head.load(std::memory_order_relaxed);
+        if (pos == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (pos == cachedTail) {
+                return std::nullopt;
+            }
+        }
+        T* value = slots[pos & mask].value();
+        std::optional<T> item(std::move(*value));
+        std::destroy_at(value);
+        head.store(pos + 1, std::memory_order_release);
+        return item;
+    }
+};
+
+// Bounded queue for any number of producers and consumers (Vyukov). Every slot carries
+// a sequence number saying whose turn it is, so a push or pop is one CAS on its own
+// cursor and producers and consumers only meet on the slot they hand over.
+template <typename T>
+class Queue<T, Mpmc>
+{
+private:
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* value() { return reinterpret_cast<T*>(storage); }
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    alignas(kCacheLine) std::atomic<size_t> enqueuePos{ 0 };
+    alignas(kCacheLine) std::atomic<size_t> dequeuePos{ 0 };
+
+public:
+    // Capacity is rounded up to a power of two.
+    explicit Queue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        slots.reset(new Slot[size]);
+        mask = size - 1;
+        for (size_t i = 0; i < size; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    Queue(const Queue&) = delete;
+    Queue& operator=(const Queue&) = delete;
+
+    ~Queue()
+    {
+        for (size_t pos = dequeuePos.load(); pos != enqueuePos.load(); pos++) {
+            std::destroy_at(slots[pos & mask].value());
+        }
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+    // False if the queue is full; args are left untouched then.
+    template <typename... Args>
+    bool try_emplace(Args&&... args)
+    {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots[pos & mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    std::construct_at(slot.value(), std::forward<Args>(args)...);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_push(const T& item) { return try_emplace(item); }
+    bool try_push(T&& item) { return try_emplace(std::move(item)); }
+
+    std::optional<T> try_pop()
+    {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots[pos & mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    std::optional<T> item(std::move(*slot.value()));
+                    std::destroy_at(slot.value());
+                    slot.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return item;
+                }
+            }
+            else if (diff < 0) {
+                return std::nullopt;
+            }
+            else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+// Bounded queue whose producers wait while it is full and whose consumers wait while it
+// is empty, so a slow consumer throttles producers instead of letting memory grow.
+// Items go through an Mpmc ring; a thread first retries that a few times and only then
+// sleeps on a condition variable. Wakers take the mutex only when someone sleeps.
+// After close(), pushes fail and pops drain what is left, then report the end.
+template <typename T>
+class Queue<T, Blocking>
+{
+private:
+    static constexpr int kSpinTries = 64;
+
+    Queue<T, Mpmc> ring;
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::atomic<int> sleepingProducers{ 0 };
+    std::atomic<int> sleepingConsumers{ 0 };
+    std::atomic<bool> closed{ false };
+    std::atomic<uint64_t> sleeps{ 0 };
+
+    // Wakes sleepers of cv if there are any. Reading the count with an RMW orders it
+    // against the increment in waitFor: either the sleeper is counted when we look, or
+    // its retry after counting itself sees our ring update.
+    void wake(std::condition_variable& cv, std::atomic<int>& sleepers, bool all)
+    {
+        if (sleepers.fetch_add(0, std::memory_order_acq_rel) > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (all) {
+                cv.notify_all();
+            }
+            else {
+                cv.notify_one();
+            }
+        }
+    }
+
+    // Runs attempt until it succeeds, the queue is closed or deadline passes (never if it
+    // is time_point::max()). attempt must have no effect when it fails.
+    template <typename Attempt>
+    bool waitFor(Attempt attempt, std::condition_variable& cv, std::atomic<int>& sleepers,
+        std::chrono::steady_clock::time_point deadline)
+    {
+        for (int i = 0; i < kSpinTries; i++) {
+            if (attempt()) {
+                return true;
+            }
+            if (closed.load(std::memory_order_acquire)) {
+                return attempt();
+            }
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        sleepers.fetch_add(1, std::memory_order_acq_rel);
+        bool done = attempt();
+        while (!done && !closed.load(std::memory_order_acquire)) {
+            sleeps.fetch_add(1, std::memory_order_relaxed);
+            if (deadline == std::chrono::steady_clock::time_point::max()) {
+                cv.wait(lock);
+            }
+            else if (cv.wait_until(lock, deadline) == std::cv_status::timeout) {
+                done = attempt();
+                break;
+            }
+            done = attempt();
+        }
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+        return done || attempt();
+    }
+
+    bool pushUntil(T&& item, std::chrono::steady_clock::time_point deadline)
+    {
+        auto attempt = [&] { return !closed.load(std::memory_order_acquire) && ring.try_push(std::move(item)); };
+        if (!waitFor(attempt, notFull, sleepingProducers, deadline)) {
+            return false;
+        }
+        wake(notEmpty, sleepingConsumers, false);
+        return true;
+    }
+
+    std::optional<T> popUntil(std::chrono::steady_clock::time_point deadline)
+    {
+        std::optional<T> item;
+        auto attempt = [&] { return (item = ring.try_pop()).has_value(); };
+        if (waitFor(attempt, notEmpty, sleepingConsumers, deadline)) {
+            wake(notFull, sleepingProducers, false);
+        }
+        return item;
+    }
+
+public:
+    // Capacity is rounded up to a power of two.
+    explicit Queue(size_t capacity) : ring(capacity) {}
+
+    size_t capacity() const { return ring.capacity(); }
+
+    // How many times a thread went to sleep on this queue.
+    uint64_t sleepCount() const { return sleeps.load(std::memory_order_relaxed); }
+
+    void close()
+    {
+        closed.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(mutex);
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+    // Waits until there is room; false once closed.
+    bool push(T&& item) { return pushUntil(std::move(item), std::chrono::steady_clock::time_point::max()); }
+    bool push(const T& item) { return push(T(item)); }
+
+    // Waits up to timeout for room. False on timeout or once closed; item is left
+    // untouched then.
+    template <typename Rep, typename Period>
+    bool push_for(T&& item, const std::chrono::duration<Rep, Period>& timeout)
+    {
+        return pushUntil(std::move(item), std::chrono::steady_clock::now() + timeout);
+    }
+
+    // Waits for an item. Empty once closed and drained.
+    std::optional<T> pop() { return popUntil(std::chrono::steady_clock::time_point::max()); }
+
+    // Waits up to timeout for an item. Empty on timeout, or once closed and drained.
+    template <typename Rep, typename Period>
+    std::optional<T> pop_for(const std::chrono::duration<Rep, Period>& timeout)
+    {
+        return popUntil(std::chrono::steady_clock::now() + timeout);
+    }
+
+    std::optional<T> try_pop()
+    {
+        std::optional<T> item = ring.try_pop();
+        if (item) {
+            wake(notFull, sleepingProducers, false);
+        }
+        return item;
+    }
+
+    // Waits for at least one item, then takes up to max without waiting again, so one
+    // wake-up serves a whole burst. Empty only once closed and drained.
+    std::vector<T> pop_batch(size_t max)
+    {
+        std::vector<T> items;
+        if (max == 0) {
+            return items;
+        }
+        std::optional<T> first = pop();
+        if (!first) {
+            return items;
+        }
+        items.push_back(std::move(*first));
+        while (items.size() < max) {
+            std::optional<T> next = ring.try_pop();
+            if (!next) {
+                break;
+            }
+            items.push_back(std::move(*next));
+        }
+        if (items.size() > 1) {
+            wake(notFull, sleepingProducers, true);
+        }
+        return items;
+    }
+};
+
+// Min-priority queue on a 4-ary heap. The heap is one contiguous array of (priority, id)
+// pairs, so the four children of a node sit next to each other (one cache line for
+// 64-bit priorities) and the tree is half as deep as a binary heap. Values live in a
+// separate table indexed by id, which also records every entry's heap position: that is
+// what lets decrease_key and cancel find an entry from its handle in O(1) before the
+// O(log n) sift. Handles carry a generation, so a stale one is reported, not misapplied.
+template <typename T, typename Priority = uint64_t>
+class PriorityQueue
+{
+public:
+    struct Handle
+    {
+        uint32_t id = UINT32_MAX;
+        uint32_t generation = 0;
+    };
+
+private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    struct Node
+    {
+        Priority priority;
+        uint32_t id;
+    };
+
+    struct Entry
+    {
+        std::optional<T> value;
+        uint32_t position;   // heap index, or the next free id while free
+        uint32_t generation;
+    };
+
+    std::vector<Node> heap;
+    std::vector<Entry> entries;
+    uint32_t freeHead = kNone;
+
+    void place(size_t index, const Node& node)
+    {
+        heap[index] = node;
+        entries[node.id].position = static_cast<uint32_t>(index);
+    }
+
+    void siftUp(size_t index)
+    {
+        Node node = heap[index];
+        while (index > 0) {
+            size_t parent = (index - 1) / 4;
+            if (!(node.priority < heap[parent].priority)) {
+                break;
+            }
+            place(index, heap[parent]);
+            index = parent;
+        }
+        place(index, node);
+    }
+
+    void siftDown(size_t index)
+    {
+        Node node = heap[index];
+        while (true) {
+            size_t first = index * 4 + 1;
+            if (first >= heap.size()) {
+                break;
+            }
+            size_t best = first;
+            size_t last = std::min(first + 4, heap.size());
+            for (size_t child = first + 1; child < last; child++) {
+                if (heap[child].priority < heap[best].priority) {
+                    best = child;
+                }
+            }
+            if (!(heap[best].priority < node.priority)) {
+                break;
+            }
+            place(index, heap[best]);
+            index = best;
+        }
+        place(index, node);
+    }
+
+    // Takes the node at index out of the heap and frees its entry; returns the value.
+    T removeAt(size_t index)
+    {
+        uint32_t id = heap[index].id;
+        Node last = heap.back();
+        heap.pop_back();
+        if (index < heap.size()) {
+            place(index, last);
+            if (index > 0 && last.priority < heap[(index - 1) / 4].priority) {
+                siftUp(index);
+            }
+            else {
+                siftDown(index);
+            }
+        }
+        Entry& entry = entries[id];
+        T value = std::move(*entry.value);
+        entry.value.reset();
+        ++entry.generation;
+        entry.position = freeHead;
+        freeHead = id;
+        return value;
+    }
+
+    const Entry* find(Handle handle) const
+    {
+        if (handle.id >= entries.size()) {
+            return nullptr;
+        }
+        const Entry& entry = entries[handle.id];
+        return entry.value && entry.generation == handle.generation ? &entry : nullptr;
+    }
+
+public:
+    size_t size() const { return heap.size(); }
+    bool empty() const { return heap.empty(); }
+
+    void reserve(size_t n)
+    {
+        heap.reserve(n);
+        entries.reserve(n);
+    }
+
+    template <typename... Args>
+    Handle emplace(Priority priority, Args&&... args)
+    {
+        uint32_t id = freeHead;
+        if (id != kNone) {
+            freeHead = entries[id].position;
+        }
+        else {
+            id = static_cast<uint32_t>(entries.size());
+            entries.push_back(Entry{ std::nullopt, 0, 0 });
+        }
+        entries[id].value.emplace(std::forward<Args>(args)...);
+        heap.push_back(Node{ priority, id });
+        siftUp(heap.size() - 1);
+        return Handle{ id, entries[id].generation };
+    }
+
+    Handle push(Priority priority, const T& value) { return emplace(priority, value); }
+    Handle push(Priority priority, T&& value) { return emplace(priority, std::move(value)); }
+
+    bool contains(Handle handle) const { return find(handle) != nullptr; }
+
+    // Moves the entry forward to an earlier (smaller) priority. False if the handle is
+    // stale; raising a priority is rejected.
+    bool decrease_key(Handle handle, Priority priority)
+    {
+        const Entry* entry = find(handle);
+        if (entry == nullptr) {
+            return false;
+        }
+        Node& node = heap[entry->position];
+        if (node.priority < priority) {
+            throw std::invalid_argument("decrease_key cannot raise a priority");
+        }
+        node.priority = priority;
+        siftUp(entry->position);
+        return true;
+    }
+
+    // Removes the entry; false if it already left the queue.
+    bool cancel(Handle handle)
+    {
+        const Entry* entry = find(handle);
+        if (entry == nullptr) {
+            return false;
+        }
+        removeAt(entry->position);
+        return true;
+    }
+
+    const T& top() const
+    {
+        if (heap.empty()) {
+            throw std::invalid_argument("Queue is empty");
+        }
+        return *entries[heap.front().id].value;
+    }
+
+    Priority top_priority() const
+    {
+        if (heap.empty()) {
+            throw std::invalid_argument("Queue is empty");
+        }
+        return heap.front().priority;
+    }
+
+    T pop()
+    {
+        if (heap.empty()) {
+            throw std::invalid_argument("Queue is empty");
+        }
+        return removeAt(0);
+    }
+
+    std::optional<T> try_pop()
+    {
+        if (heap.empty()) {
+            return std::nullopt;
+        }
+        return removeAt(0);
+    }
+};
+
+// Hierarchical timing wheel for very many timers. Time advances in whole ticks. Level l
+// has 64 slots of 64^l ticks each, so four levels cover 64^4 ticks directly; anything
+// further out parks in the top level and is re-filed when that slot comes round. A
+// timer is filed in O(1) by the highest differing bits of its expiry, cascades down at
+// most once per level on its way to level 0, and is fired from there. Slots are plain
+// arrays of (expiry, node, generation), so a cascade scans memory in order without
+// touching the values; cancel just retires the node, and its stale slot entries are
+// dropped when they come up.
+template <typename T>
+class TimingWheel
+{
+public:
+    struct Handle
+    {
+        uint32_t node = UINT32_MAX;
+        uint32_t generation = 0;
+    };
+
+private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+    static constexpr int kBits = 6;
+    static constexpr int kLevels = 4;
+    static constexpr uint64_t kSlots = uint64_t(1) << kBits;
+
+    struct Timer
+    {
+        uint64_t expiry;
+        uint32_t node;
+        uint32_t generation;
+    };
+
+    struct Node
+    {
+        std::optional<T> value;
+        uint32_t generation;
+        uint32_t nextFree;
+    };
+
+    std::vector<Node> nodes;
+    std::array<std::vector<Timer>, kLevels * kSlots> slots;
+    uint32_t freeHead = kNone;
+    uint64_t now = 0;
+    size_t active = 0;
+    std::vector<Timer> due; // a slot being emptied; swapped with it to keep both buffers
+
+    void file(const Timer& timer)
+    {
+        uint64_t delta = timer.expiry - now;
+        int level = 0;
+        while (level < kLevels - 1 && delta >= (uint64_t(1) << (kBits * (level + 1)))) {
+            level++;
+        }
+        slots[level * kSlots + ((timer.expiry >> (kBits * level)) & (kSlots - 1))].push_back(timer);
+    }
+
+    bool live(uint32_t node, uint32_t generation) const
+    {
+        return node < nodes.size() && nodes[node].value && nodes[node].generation == generation;
+    }
+
+    T release(uint32_t id)
+    {
+        Node& node = nodes[id];
+        T value = std::move(*node.value);
+        node.value.reset();
+        ++node.generation;
+        node.nextFree = freeHead;
+        freeHead = id;
+        active--;
+        return value;
+    }
+
+    // Swaps the contents of a slot into due, leaving the slot empty.
+    void takeSlot(size_t slot)
+    {
+        due.clear();
+        std::swap(due, slots[slot]);
+    }
+
+public:
+    uint64_t time() const { return now; }
+    size_t size() const { return active; }
+
+    // Fires value delay ticks from now (at least one).
+    template <typename... Args>
+    Handle schedule(uint64_t delay, Args&&... args)
+    {
+        uint32_t id = freeHead;
+        if (id != kNone) {
+            freeHead = nodes[id].nextFree;
+        }
+        else {
+            id = static_cast<uint32_t>(nodes.size());
+            nodes.push_back(Node{ std::nullopt, 0, kNone });
+        }
+        nodes[id].value.emplace(std::forward<Args>(args)...);
+        file(Timer{ now + std::max<uint64_t>(delay, 1), id, nodes[id].generation });
+        active++;
+        return Handle{ id, nodes[id].generation };
+    }
+
+    // Stops the timer; false if it already fired or was cancelled.
+    bool cancel(Handle handle)
+    {
+        if (!live(handle.node, handle.generation)) {
+            return false;
+        }
+        release(handle.node);
+        return true;
+    }
+
+    // Moves time forward by ticks, calling onExpire(T&&) for every timer that comes due,
+    // in tick order. onExpire may schedule and cancel timers, but not call advance.
+    // Returns how many fired.
+    template <typename F>
+    size_t advance(uint64_t ticks, F&& onExpire)
+    {
+        size_t fired = 0;
+        for (uint64_t i = 0; i < ticks; i++) {
+            now++;
+            for (int level = kLevels - 1; level > 0; level--) {
+                if ((now & ((uint64_t(1) << (kBits * level)) - 1)) == 0) {
+                    takeSlot(level * kSlots + ((now >> (kBits * level)) & (kSlots - 1)));
+                    for (const Timer& timer : due) {
+                        file(timer);
+                    }
+                }
+            }
+            size_t slot = now & (kSlots - 1);
+            if (slots[slot].empty()) {
+                continue;
+            }
+            takeSlot(slot);
+            for (const Timer& timer : due) {
+                // Skips timers cancelled before or during this batch.
+                if (live(timer.node, timer.generation)) {
+                    fired++;
+                    onExpire(release(timer.node));
+                }
+            }
+        }
+        return fired;
+    }
+};
+
+// Moves items from producers to consumers through queue; every item is the
+// steady_clock time it was pushed at, so consumers also sample how long items waited.
+struct TransferResult
+{
+    double itemsPerSecond;
+    double medianLatencyNs;
+    double p99LatencyNs;
+};
+
+uint64_t nowNs()
 {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+template <typename Q>
+TransferResult transfer(Q& queue, unsigned producers, unsigned consumers, size_t items)
+{
+    constexpr size_t kSampleEvery = 64;
+    std::atomic<size_t> consumed{ 0 };
+    std::vector<std::vector<uint64_t>> latencies(consumers);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned p = 0; p < producers; p++) {
+        threads.emplace_back([&, p] {
+            for (size_t i = p; i < items; i += producers) {
+                while (!queue.try_push(nowNs())) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (unsigned c = 0; c < consumers; c++) {
+        threads.emplace_back([&, c] {
+            size_t taken = 0;
+            while (consumed.load(std::memory_order_relaxed) < items) {
+                std::optional<uint64_t> stamp = queue.try_pop();
+                if (!stamp) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                if (taken++ % kSampleEvery == 0) {
+                    latencies[c].push_back(nowNs() - *stamp);
+                }
+                consumed.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<uint64_t> all;
+    for (const auto& samples : latencies) {
+        all.insert(all.end(), samples.begin(), samples.end());
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&](double p) {
+        return all.empty() ? 0.0 : static_cast<double>(all[static_cast<size_t>(p * (all.size() - 1))]);
+    };
+    return { items / seconds, percentile(0.5), percentile(0.99) };
+}
+
+// "6_0 bench [items] [capacity]": throughput and queueing latency of the lock-free
+// variants for several producer/consumer counts, next to a mutex around Queue.
+int runBenchmark(size_t items, size_t capacity)
+{
+    struct LockedQueue
+    {
+        std::mutex mutex;
+        Queue<uint64_t> queue;
+        size_t capacity;
+
+        bool try_push(uint64_t item)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queue.size() >= capacity) {
+                return false;
+            }
+            queue.push(item);
+            return true;
+        }
+
+        std::optional<uint64_t> try_pop()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return queue.try_pop();
+        }
+    };
+
+    auto report = [](const char* name, unsigned producers, unsigned consumers, const TransferResult& result) {
+        std::cout << name << " " << producers << "P/" << consumers << "C: "
+            << static_cast<uint64_t>(result.itemsPerSecond) << " items/s, latency p50 "
+            << result.medianLatencyNs << " ns, p99 " << result.p99LatencyNs << " ns\n";
+    };
+
+    {
+        Queue<uint64_t, Spsc> queue(capacity);
+        report("Spsc  ", 1, 1, transfer(queue, 1, 1, items));
+    }
+    const std::pair<unsigned, unsigned> shapes[] = { { 1, 1 }, { 2, 2 }, { 4, 4 }, { 1, 4 }, { 4, 1 } };
+    for (auto [producers, consumers] : shapes) {
+        Queue<uint64_t, Mpmc> queue(capacity);
+        report("Mpmc  ", producers, consumers, transfer(queue, producers, consumers, items));
+        LockedQueue locked{ {}, {}, capacity };
+        report("Locked", producers, consumers, transfer(locked, producers, consumers, items));
+    }
+    return 0;
+}
+
+// "6_0 bench-blocking [items] [capacity]": producers feed one consumer that does a
+// little work per item, so producers keep hitting the capacity and have to wait. The
+// consumer takes items one at a time with pop() or in bursts with pop_batch(64); the
+// sleep count shows how many context switches the batches save.
+int runBlockingBenchmark(size_t items, size_t capacity)
+{
+    auto work = [](uint64_t item) {
+        uint64_t x = item;
+        for (int i = 0; i < 50; i++) {
+            x = x * 6364136223846793005ull + 1442695040888963407ull;
+        }
+        return x;
+    };
+
+    std::cout << "producers  consumer      items/s  sleeps per 1000 items\n";
+    for (unsigned producers : { 1u, 2u, 4u }) {
+        for (size_t batch : { size_t(1), size_t(64) }) {
+            Queue<uint64_t, Blocking> queue(capacity);
+            std::atomic<uint64_t> sink{ 0 };
+            auto start = std::chrono::steady_clock::now();
+            std::thread consumer([&] {
+                uint64_t sum = 0;
+                if (batch == 1) {
+                    while (std::optional<uint64_t> item = queue.pop()) {
+                        sum += work(*item);
+                    }
+                }
+                else {
+                    for (std::vector<uint64_t> items = queue.pop_batch(batch); !items.empty(); items = queue.pop_batch(batch)) {
+                        for (uint64_t item : items) {
+                            sum += work(item);
+                        }
+                    }
+                }
+                sink.store(sum);
+            });
+            std::vector<std::thread> threads;
+            for (unsigned p = 0; p < producers; p++) {
+                threads.emplace_back([&, p] {
+                    for (size_t i = p; i < items; i += producers) {
+                        queue.push(static_cast<uint64_t>(i));
+                    }
+                });
+            }
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
+            queue.close();
+            consumer.join();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << producers << "          " << (batch == 1 ? "pop()        " : "pop_batch(64)") << "  "
+                << static_cast<uint64_t>(items / seconds) << "  " << queue.sleepCount() * 1000.0 / items << "\n";
+        }
+    }
+    return 0;
+}
+
+// "6_0 bench-timers [events]": schedules events at random times up to a million ticks
+// out, moves 10% earlier and cancels 10%, then runs them all. Times are per scheduled
+// event, with std::priority_queue (no decrease-key or cancel) as the baseline. Both
+// queues check that every event runs at its own time, in order.
+int runTimerBenchmark(size_t events)
+{
+    constexpr uint64_t kHorizon = uint64_t(1) << 20;
+    std::mt19937_64 random(1);
+    std::vector<uint64_t> times(events);
+    for (uint64_t& time : times) {
+        time = 1 + random() % kHorizon;
+    }
+    auto nsPerEvent = [&](auto start) {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / events;
+    };
+    bool ordered = true;
+
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>> queue(std::greater<uint64_t>(), [&] {
+            std::vector<uint64_t> storage;
+            storage.reserve(events);
+            return storage;
+        }());
+        for (uint64_t time : times) {
+            queue.push(time);
+        }
+        uint64_t last = 0;
+        while (!queue.empty()) {
+            ordered = ordered && queue.top() >= last;
+            last = queue.top();
+            queue.pop();
+        }
+        std::cout << "std::priority_queue  " << nsPerEvent(start) << " ns per event\n";
+    }
+
+    {
+        auto start = std::chrono::steady_clock::now();
+        PriorityQueue<uint64_t> queue;
+        queue.reserve(events);
+        std::vector<PriorityQueue<uint64_t>::Handle> handles;
+        handles.reserve(events);
+        for (uint64_t time : times) {
+            handles.push_back(queue.push(time, time));
+        }
+        for (size_t i = 0; i < events; i += 10) {
+            queue.cancel(handles[i]);
+            uint64_t earlier = times[i + 5 < events ? i + 5 : i] / 2;
+            if (i + 5 < events && queue.decrease_key(handles[i + 5], earlier)) {
+                times[i + 5] = earlier;
+            }
+        }
+        uint64_t last = 0;
+        while (!queue.empty()) {
+            uint64_t time = queue.top_priority();
+            ordered = ordered && time >= last;
+            last = time;
+            queue.pop();
+        }
+        std::cout << "PriorityQueue        " << nsPerEvent(start) << " ns per event\n";
+    }
+
+    {
+        auto start = std::chrono::steady_clock::now();
+        TimingWheel<uint64_t> wheel;
+        std::vector<TimingWheel<uint64_t>::Handle> handles;
+        handles.reserve(events);
+        for (uint64_t time : times) {
+            handles.push_back(wheel.schedule(time, time));
+        }
+        for (size_t i = 0; i < events; i += 10) {
+            wheel.cancel(handles[i]);
+        }
+        size_t fired = wheel.advance(kHorizon, [&](uint64_t time) {
+            ordered = ordered && time == wheel.time();
+        });
+        ordered = ordered && fired == events - (events + 9) / 10 && wheel.size() == 0;
+        std::cout << "TimingWheel          " << nsPerEvent(start) << " ns per event\n";
+    }
+
+    std::cout << (ordered ? "All events ran in order\n" : "Events ran OUT OF ORDER\n");
+    return ordered ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && std::string(argv[1]) == "bench-timers") {
+        return runTimerBenchmark(argc > 2 ? std::stoul(argv[2]) : 1000000);
+    }
+    if (argc > 1 && std::string(argv[1]) == "bench-blocking") {
+        return runBlockingBenchmark(argc > 2 ? std::stoul(argv[2]) : 1000000, argc > 3 ? std::stoul(argv[3]) : 256);
+    }
+    if (argc > 1 && std::string(argv[1]) == "bench") {
+        return runBenchmark(argc > 2 ? std::stoul(argv[2]) : 1000000, argc > 3 ? std::stoul(argv[3]) : 1024);
+    }
+
     try
     {
         std::cout << "Empty queue:\n";
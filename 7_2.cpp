@@ -5,6 +5,238 @@
 #include <cstdlib>
 #include <iostream>
 #include <string>
+#include <cstdint>
+#include <random>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <condition_variable>
+#include <memory>
+#include <algorithm>
+#include <new>
+#include <sstream>
+#include <coroutine>
+#include <queue>
+#include <optional>
+
+class FastRandom {
+private:
+    uint64_t state[4];
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+public:
+    explicit FastRandom(uint64_t seed = 0, uint64_t stream = 0) { reseed(seed, stream); }
+
+    void reseed(uint64_t seed, uint64_t stream = 0) {
+        uint64_t mix = seed ^ (stream * 0xD1B54A32D192ED03ull);
+        for (uint64_t& word : state) {
+            uint64_t z = (mix += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t next() {
+        const uint64_t result = rotl(state[1] * 5, 7) * 9;
+        const uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
+    }
+
+    uint32_t below(uint32_t bound) {
+        uint64_t m = (next() >> 32) * bound;
+        if (static_cast<uint32_t>(m) < bound) {
+            const uint32_t threshold = (0u - bound) % bound;
+            while (static_cast<uint32_t>(m) < threshold) {
+                m = (next() >> 32) * bound;
+            }
+        }
+        return static_cast<uint32_t>(m >> 32);
+    }
+};
+
+// Each thread rolls with its own generator. Threads seed it with (gameSeed, their stream)
+// so a run is reproducible from gameSeed.
+inline FastRandom& gameRandom() {
+    thread_local FastRandom random;
+    return random;
+}
+
+uint64_t gameSeed = std::random_device{}();
+
+// Bounded multi-producer/multi-consumer queue (Vyukov). Every slot carries a sequence
+// number saying whose turn it is: a push or pop is a single CAS on its own cursor, and
+// producers and consumers only meet on the slot they hand over. Elements are moved in
+// and out, so move-only types work.
+template<typename T>
+class BoundedQueue {
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* value() { return reinterpret_cast<T*>(storage); }
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> enqueuePos{ 0 };
+    alignas(64) std::atomic<size_t> dequeuePos{ 0 };
+
+public:
+    // Capacity is rounded up to a power of two.
+    explicit BoundedQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        slots.reset(new Slot[size]);
+        mask = size - 1;
+        for (size_t i = 0; i < size; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    ~BoundedQueue() {
+        for (size_t pos = dequeuePos.load(); pos != enqueuePos.load(); ++pos) {
+            slots[pos & mask].value()->~T();
+        }
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+    // False if the queue is full; value is left untouched then.
+    bool tryPush(T&& value) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots[pos & mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    new (slot.storage) T(std::move(value));
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Claims up to maxCount consecutive ready elements with one CAS and appends them to
+    // out. Returns how many were taken, 0 if the queue is empty or maxCount is 0.
+    size_t tryPopBatch(std::vector<T>& out, size_t maxCount) {
+        if (maxCount == 0) {
+            return 0;
+        }
+        out.reserve(out.size() + std::min(maxCount, capacity()));
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        while (true) {
+            size_t ready = 0;
+            while (ready < maxCount && ready <= mask
+                && slots[(pos + ready) & mask].sequence.load(std::memory_order_acquire) == pos + ready + 1) {
+                ++ready;
+            }
+            if (ready == 0) {
+                size_t sequence = slots[pos & mask].sequence.load(std::memory_order_acquire);
+                if (static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1) < 0) {
+                    return 0;
+                }
+                pos = dequeuePos.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (dequeuePos.compare_exchange_weak(pos, pos + ready, std::memory_order_relaxed)) {
+                for (size_t i = 0; i < ready; ++i) {
+                    Slot& slot = slots[(pos + i) & mask];
+                    out.push_back(std::move(*slot.value()));
+                    slot.value()->~T();
+                    slot.sequence.store(pos + i + mask + 1, std::memory_order_release);
+                }
+                return ready;
+            }
+        }
+    }
+};
+
+// Console output is queued and written by one drain thread, so fights never wait on the
+// terminal or on each other. When the queue is full the line is dropped and counted.
+class Console {
+private:
+    BoundedQueue<std::string> lines{ 4096 };
+    std::atomic<uint64_t> dropped{ 0 };
+    std::atomic<bool> muted{ false };
+    std::atomic<bool> stopping{ false };
+    std::thread drainThread;
+
+    void drain() {
+        std::vector<std::string> batch;
+        while (true) {
+            bool stop = stopping.load();
+            batch.clear();
+            if (lines.tryPopBatch(batch, 64) == 0) {
+                if (stop) {
+                    break;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            for (const std::string& line : batch) {
+                std::cout << line;
+            }
+            std::cout.flush();
+        }
+        if (dropped > 0) {
+            std::cout << dropped << " console lines dropped\n";
+        }
+    }
+
+public:
+    Console() : drainThread(&Console::drain, this) {}
+
+    ~Console() {
+        stopping = true;
+        drainThread.join();
+    }
+
+    void write(std::string line) {
+        if (!lines.tryPush(std::move(line))) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void mute(bool on) { muted = on; }
+    bool isMuted() const { return muted.load(std::memory_order_relaxed); }
+};
+
+inline Console& console() {
+    static Console instance;
+    return instance;
+}
+
+template<typename... Parts>
+void say(const Parts&... parts) {
+    if (console().isMuted()) {
+        return;
+    }
+    std::ostringstream line;
+    (line << ... << parts);
+    console().write(line.str());
+}
 
 class Entity
 {
@@ -16,6 +248,10 @@ protected:
 public:
     Entity(const std::string& n, int h, int d)
         : name(n), HP(h), damage(d) {}
+    Entity(const Entity&) = default;
+    Entity(Entity&&) = default;
+    Entity& operator=(const Entity&) = default;
+    Entity& operator=(Entity&&) = default;
 
     std::string getName() const { return name; }
     int getHP() const { return HP; }
@@ -37,39 +273,38 @@ public:
     void attack(Entity& target) override
     {
         int attackDamage = damage;
-        if (rand() % 100 < 30)
+        if (gameRandom().below(100) < 30)
         {
             attackDamage *= 2;
-            std::cout << "Strong hit! " << name << " attacks " << target.getName() << " for " << damage * 2 << " damage!\n";
+            say("Strong hit! ", name, " attacks ", target.getName(), " for ", damage * 2, " damage!\n");
         }
         else {
-            std::cout << name << " attacks " << target.getName() << " for " << damage << " damage!\n";
+            say(name, " attacks ", target.getName(), " for ", damage, " damage!\n");
         }
         target.takeDamage(attackDamage);
     };
 
     void heal(int amount) {
-        if (rand() % 100 < 5)
+        if (gameRandom().below(100) < 5)
         {
             HP += amount * 2;
             if (HP > 200){
                 HP = 200;
             }
-            std::cout << "Big potion! Character healed with " << amount * 2 << " HP\n";
+            say("Big potion! Character healed with ", amount * 2, " HP\n");
         }
         else {
             HP += amount;
             if (HP > 200) {
                 HP = 200;
             }
-            std::cout << "Character healed with " << amount << " HP\n";
+            say("Character healed with ", amount, " HP\n");
         }
     }
 
     void displayInfo() const override
     {
-        std::cout << "Hero: " << name << ", HP: " << HP
-            << ", Damage: " << damage << std::endl;
+        say("Hero: ", name, ", HP: ", HP, ", Damage: ", damage, "\n");
     }
 
     virtual ~Hero() {}
@@ -84,83 +319,931 @@ public:
     void attack(Entity& target) override
     {
         int attackDamage = damage;
-        if (rand() % 100 < 10)
+        if (gameRandom().below(100) < 10)
         {
             attackDamage *= 3;
-            std::cout << "Hit in the back! " << name << " attacks " 
-                << target.getName() << " for " << damage * 3 << " damage!\n";;
+            say("Hit in the back! ", name, " attacks ", target.getName(), " for ", damage * 3, " damage!\n");
         }
         else {
-            std::cout << name << " attacks " << target.getName() << " for " << damage << " damage!\n";
+            say(name, " attacks ", target.getName(), " for ", damage, " damage!\n");
         }
         target.takeDamage(attackDamage);
     }
 
     void displayInfo() const override
     {
-        std::cout << "Monster: " << name << ", HP: " << HP
-            << ", Attack: " << damage << std::endl;
+        say("Monster: ", name, ", HP: ", HP, ", Attack: ", damage, "\n");
     }
 
-    virtual ~Monster() {}
 };
 
-std::vector<Monster> monsters;
-std::mutex monstersMutex;
-std::mutex fightMutex;
+BoundedQueue<Monster> monsters(1024);
 
-void generateMonsters() {
-    while (true) {
-        std::this_thread::sleep_for(std::chrono::seconds(2));
-        std::lock_guard<std::mutex> lock(monstersMutex);
-        monsters.push_back(Monster("Goblin_" + std::to_string(rand() % 100), 50, 25));
-        std::cout << "New monster generated!\n";
-    }
-}
-void fight(Hero& hero, Monster& monster) {
-    std::cout << "\nBattle of " << hero.getName() << " and " << monster.getName() << "!\n";
-    while (hero.isAlive() && monster.isAlive()) {
-        std::lock_guard<std::mutex> lock(fightMutex);
+// One fight, advanced a round at a time. The fight rolls with its own stream
+// (gameSeed, fightNumber), swapped into gameRandom() for the round, so the result does
+// not depend on which thread runs which round.
+// The caller owns both sides for the whole fight (a busy HeroSlot, a monster moved out
+// of the queue), so fights between different pairs share nothing and take no lock.
+class Fight {
+private:
+    Hero& hero;
+    Monster& monster;
+    FastRandom random;
+    bool started = false;
+    bool over = false;
+
+public:
+    Fight(Hero& hero, Monster& monster, uint64_t fightNumber)
+        : hero(hero), monster(monster), random(gameSeed, fightNumber) {}
+
+    bool isOver() const { return over; }
+
+    // Plays one exchange of blows; returns false once the fight is over.
+    bool round() {
+        if (over) {
+            return false;
+        }
+        std::swap(gameRandom(), random);
+        if (!started) {
+            say("\nBattle of ", hero.getName(), " and ", monster.getName(), "!\n");
+            started = true;
+        }
 
         hero.attack(monster);
         if (!monster.isAlive()) {
-            std::cout << monster.getName() << " defeated!\n";
-            break;
+            say(monster.getName(), " defeated!\n");
+            over = true;
+        }
+        else {
+            monster.attack(hero);
+            if (!hero.isAlive()) {
+                say(hero.getName(), " defeated!\n");
+                over = true;
+            }
+        }
+
+        if (over && hero.isAlive()) {
+            hero.heal(15);
+        }
+        std::swap(gameRandom(), random);
+        return !over;
+    }
+};
+
+void fight(Hero& hero, Monster& monster, uint64_t fightNumber,
+    std::chrono::milliseconds roundDelay = std::chrono::milliseconds(500)) {
+    Fight fight(hero, monster, fightNumber);
+    while (fight.round()) {
+        std::this_thread::sleep_for(roundDelay);
+    }
+}
+
+// Logical time of the arena: one tick is one combat round. In real-time mode advance()
+// sleeps until the tick's wall-clock deadline; in fast-forward mode ticks run back to
+// back. Game logic only looks at tick numbers, so both modes play the same game.
+class SimulationClock {
+private:
+    std::chrono::steady_clock::duration tickLength;
+    bool realTime;
+    uint64_t ticks = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+public:
+    SimulationClock(std::chrono::steady_clock::duration tickLength, bool realTime)
+        : tickLength(tickLength), realTime(realTime) {}
+
+    uint64_t now() const { return ticks; }
+    double gameSeconds() const { return std::chrono::duration<double>(ticks * tickLength).count(); }
+
+    // Number of ticks in a span of game time, at least one.
+    uint64_t ticksIn(std::chrono::steady_clock::duration span) const {
+        return std::max<uint64_t>(span / tickLength, 1);
+    }
+
+    uint64_t advance() {
+        ++ticks;
+        if (realTime) {
+            std::this_thread::sleep_until(start + ticks * tickLength);
+        }
+        return ticks;
+    }
+};
+
+// Work-stealing pool: every worker owns a deque, takes its newest task from the back and,
+// when it runs dry, steals the oldest task from another worker. Tasks submitted from
+// outside the pool are dealt round-robin. Timing is up to the caller (see
+// SimulationClock); the pool only runs what it is given.
+class ThreadPool {
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> queued{ 0 };
+    std::atomic<size_t> unfinished{ 0 };
+    std::atomic<size_t> sleepers{ 0 };
+    std::atomic<size_t> nextWorker{ 0 };
+    std::atomic<bool> stopping{ false };
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+
+    static thread_local ThreadPool* currentPool;
+    static thread_local size_t currentWorker;
+
+    void push(size_t index, std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(workers[index]->mutex);
+            workers[index]->tasks.push_back(std::move(task));
+        }
+        queued.fetch_add(1);
+        if (sleepers.load() > 0) {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            wake.notify_one();
+        }
+    }
+
+    bool popLocal(size_t index, std::function<void()>& task) {
+        Worker& worker = *workers[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.tasks.empty()) {
+            return false;
+        }
+        task = std::move(worker.tasks.back());
+        worker.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(size_t thief, std::function<void()>& task) {
+        for (size_t i = 1; i < workers.size(); ++i) {
+            Worker& victim = *workers[(thief + i) % workers.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(size_t index) {
+        currentPool = this;
+        currentWorker = index;
+        std::function<void()> task;
+        while (true) {
+            if (popLocal(index, task) || steal(index, task)) {
+                queued.fetch_sub(1);
+                task();
+                task = nullptr;
+                if (unfinished.fetch_sub(1) == 1) {
+                    std::lock_guard<std::mutex> lock(sleepMutex);
+                    idle.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            if (stopping) {
+                return;
+            }
+            // push() bumps queued before it looks at sleepers, so either it sees this
+            // worker counted or this check sees its task.
+            sleepers.fetch_add(1);
+            if (queued.load() == 0) {
+                wake.wait(lock);
+            }
+            sleepers.fetch_sub(1);
+        }
+    }
+
+public:
+    explicit ThreadPool(unsigned threadCount) {
+        threadCount = std::max(threadCount, 1u);
+        for (unsigned i = 0; i < threadCount; ++i) {
+            workers.push_back(std::make_unique<Worker>());
+        }
+        for (unsigned i = 0; i < threadCount; ++i) {
+            threads.emplace_back(&ThreadPool::run, this, i);
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+            wake.notify_all();
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    size_t size() const { return workers.size(); }
+
+    // From a worker the task goes to that worker's own deque, so work spawned by a task
+    // stays local until someone steals it.
+    void submit(std::function<void()> task) {
+        unfinished.fetch_add(1);
+        size_t index = currentPool == this ? currentWorker : nextWorker.fetch_add(1) % workers.size();
+        push(index, std::move(task));
+    }
+
+    // Blocks until every submitted task has finished.
+    void wait() {
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        idle.wait(lock, [&] { return unfinished.load() == 0; });
+    }
+};
+
+thread_local ThreadPool* ThreadPool::currentPool = nullptr;
+thread_local size_t ThreadPool::currentWorker = 0;
+
+// A hero and the flag that keeps it in one fight at a time.
+struct HeroSlot {
+    Hero hero;
+    std::atomic<bool> busy{ false };
+
+    HeroSlot(const std::string& name, int hp, int damage) : hero(name, hp, damage) {}
+};
+
+// "bench [fights] [maxThreads]": completed fights per second on 1..maxThreads workers.
+// Each hero is a task that spawns its fights as subtasks, which idle workers steal.
+// Rounds are not paced and console output is muted.
+int runBenchmark(uint64_t fightCount, unsigned maxThreads) {
+    const uint64_t heroCount = 64;
+    double baseline = 0;
+    say("threads  fights/s  speedup\n");
+    for (unsigned threads = 1; threads <= maxThreads; ++threads) {
+        std::atomic<uint64_t> completed{ 0 };
+        console().mute(true);
+        auto start = std::chrono::steady_clock::now();
+        {
+            ThreadPool pool(threads);
+            for (uint64_t h = 0; h < heroCount; ++h) {
+                pool.submit([&, h] {
+                    for (uint64_t i = h; i < fightCount; i += heroCount) {
+                        pool.submit([&, h, i] {
+                            Hero hero("Knight_" + std::to_string(h + 1), 80, 25);
+                            Monster monster("Goblin", 50, 25);
+                            fight(hero, monster, i + 1, std::chrono::milliseconds(0));
+                            completed.fetch_add(1, std::memory_order_relaxed);
+                        });
+                    }
+                });
+            }
+            pool.wait();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        console().mute(false);
+
+        double rate = completed / seconds;
+        if (threads == 1) {
+            baseline = rate;
+        }
+        say(threads, "  ", static_cast<uint64_t>(rate), "  ", rate / baseline, "x\n");
+    }
+    return 0;
+}
+
+// "bench-queue [producers] [consumers] [monsters]": hands monsters from producer threads
+// to consumer threads through the old vector + mutex and through BoundedQueue.
+template<typename Push, typename PopBatch>
+double measureHandoff(int producers, int consumers, uint64_t count, Push push, PopBatch popBatch) {
+    std::atomic<uint64_t> consumed{ 0 };
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            for (uint64_t i = p; i < count; i += producers) {
+                Monster monster("Goblin_" + std::to_string(i % 100), 50, 25);
+                while (!push(std::move(monster))) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (int c = 0; c < consumers; ++c) {
+        threads.emplace_back([&] {
+            std::vector<Monster> batch;
+            while (consumed.load(std::memory_order_relaxed) < count) {
+                batch.clear();
+                size_t taken = popBatch(batch);
+                if (taken == 0) {
+                    std::this_thread::yield();
+                }
+                consumed.fetch_add(taken, std::memory_order_relaxed);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int runQueueBenchmark(int producers, int consumers, uint64_t count) {
+    const size_t kBatch = 32;
+
+    // An empty batch request must not take anything (or spin) while monsters are queued.
+    {
+        BoundedQueue<Monster> queue(4);
+        queue.tryPush(Monster("Goblin", 50, 25));
+        std::vector<Monster> out;
+        if (queue.tryPopBatch(out, 0) != 0 || !out.empty() || queue.tryPopBatch(out, kBatch) != 1) {
+            say("tryPopBatch with maxCount 0 is broken\n");
+            return 1;
+        }
+    }
+
+    std::deque<Monster> locked;
+    std::mutex lockedMutex;
+    auto lockedPush = [&](Monster&& monster) {
+        std::lock_guard<std::mutex> lock(lockedMutex);
+        if (locked.size() >= 1024) {
+            return false;
+        }
+        locked.push_back(std::move(monster));
+        return true;
+    };
+    auto lockedPop = [&](std::vector<Monster>& out, size_t maxCount) {
+        std::lock_guard<std::mutex> lock(lockedMutex);
+        size_t taken = std::min(maxCount, locked.size());
+        for (size_t i = 0; i < taken; ++i) {
+            out.push_back(std::move(locked.front()));
+            locked.pop_front();
+        }
+        return taken;
+    };
+
+    // Same pop size on both sides of each comparison: one at a time, then kBatch at a time.
+    say(producers, " producers, ", consumers, " consumers, ", count, " monsters\n");
+    for (size_t popSize : { size_t(1), kBatch }) {
+        double mutexSeconds = measureHandoff(producers, consumers, count, lockedPush,
+            [&](std::vector<Monster>& out) { return lockedPop(out, popSize); });
+        BoundedQueue<Monster> queue(1024);
+        double queueSeconds = measureHandoff(producers, consumers, count,
+            [&](Monster&& monster) { return queue.tryPush(std::move(monster)); },
+            [&](std::vector<Monster>& out) { return queue.tryPopBatch(out, popSize); });
+        say("pop ", popSize, " at a time\n");
+        say("  deque + mutex: ", static_cast<uint64_t>(count / mutexSeconds), " monsters/s\n");
+        say("  BoundedQueue:  ", static_cast<uint64_t>(count / queueSeconds), " monsters/s (",
+            mutexSeconds / queueSeconds, "x)\n");
+    }
+    return 0;
+}
+
+// Coroutine fights: a fight suspends on a timer between rounds instead of sleeping, so a
+// few threads can keep hundreds of thousands of fights in flight.
+
+class CoroutineScheduler;
+
+// Return type of a fight coroutine. It starts suspended until the scheduler picks it up
+// and frees its own frame when it finishes.
+struct FightTask {
+    struct promise_type {
+        static inline std::atomic<uint64_t> frameBytes{ 0 };
+        static inline std::atomic<uint64_t> liveFrames{ 0 };
+        static inline std::atomic<uint64_t> peakFrames{ 0 };
+
+        static void* operator new(size_t size) {
+            frameBytes.store(size, std::memory_order_relaxed);
+            uint64_t live = liveFrames.fetch_add(1, std::memory_order_relaxed) + 1;
+            uint64_t peak = peakFrames.load(std::memory_order_relaxed);
+            while (live > peak && !peakFrames.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+            }
+            return ::operator new(size);
+        }
+
+        static void operator delete(void* frame, size_t) {
+            liveFrames.fetch_sub(1, std::memory_order_relaxed);
+            ::operator delete(frame);
+        }
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+            void await_suspend(std::coroutine_handle<promise_type> handle) noexcept;
+            void await_resume() noexcept {}
+        };
+
+        FightTask get_return_object() { return FightTask{ std::coroutine_handle<promise_type>::from_promise(*this) }; }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+// Runs coroutines on a fixed set of threads. Every worker owns a timer heap and an inbox;
+// a coroutine stays on the worker it was given to, so timers need no locking and only
+// spawning, or handing back a coroutine parked outside the scheduler, crosses threads.
+class CoroutineScheduler {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Timer {
+        Clock::time_point due;
+        std::coroutine_handle<> handle;
+
+        bool operator>(const Timer& other) const { return due > other.due; }
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::vector<std::coroutine_handle<>> inbox;
+        std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<uint64_t> live{ 0 };
+    std::atomic<size_t> nextWorker{ 0 };
+    std::atomic<bool> stopping{ false };
+    std::mutex idleMutex;
+    std::condition_variable idle;
+
+    static thread_local CoroutineScheduler* currentScheduler;
+    static thread_local Worker* currentWorker;
+
+    void run(Worker& worker) {
+        currentScheduler = this;
+        currentWorker = &worker;
+        std::vector<std::coroutine_handle<>> ready;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(worker.mutex);
+                if (worker.inbox.empty()) {
+                    if (stopping) {
+                        return;
+                    }
+                    if (worker.timers.empty()) {
+                        worker.wake.wait(lock, [&] { return stopping || !worker.inbox.empty(); });
+                    }
+                    else if (worker.timers.top().due > Clock::now()) {
+                        worker.wake.wait_until(lock, worker.timers.top().due, [&] { return stopping || !worker.inbox.empty(); });
+                    }
+                }
+                ready.swap(worker.inbox);
+            }
+            for (std::coroutine_handle<> handle : ready) {
+                handle.resume();
+            }
+            ready.clear();
+
+            Clock::time_point now = Clock::now();
+            while (!worker.timers.empty() && worker.timers.top().due <= now) {
+                std::coroutine_handle<> handle = worker.timers.top().handle;
+                worker.timers.pop();
+                handle.resume();
+            }
+        }
+    }
+
+public:
+    explicit CoroutineScheduler(unsigned threadCount) {
+        threadCount = std::max(threadCount, 1u);
+        for (unsigned i = 0; i < threadCount; ++i) {
+            workers.push_back(std::make_unique<Worker>());
+        }
+        for (unsigned i = 0; i < threadCount; ++i) {
+            threads.emplace_back(&CoroutineScheduler::run, this, std::ref(*workers[i]));
+        }
+    }
+
+    CoroutineScheduler(const CoroutineScheduler&) = delete;
+    CoroutineScheduler& operator=(const CoroutineScheduler&) = delete;
+
+    ~CoroutineScheduler() {
+        stopping = true;
+        for (auto& worker : workers) {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            worker->wake.notify_one();
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    void spawn(FightTask task) {
+        live.fetch_add(1);
+        Worker& worker = *workers[nextWorker.fetch_add(1) % workers.size()];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.inbox.push_back(task.handle);
+        worker.wake.notify_one();
+    }
+
+    // Hands a coroutine that an awaitable parked outside the scheduler back to a worker.
+    void resume(std::coroutine_handle<> handle) {
+        Worker& worker = *workers[nextWorker.fetch_add(1) % workers.size()];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.inbox.push_back(handle);
+        worker.wake.notify_one();
+    }
+
+    // Blocks until every spawned coroutine has finished.
+    void wait() {
+        std::unique_lock<std::mutex> lock(idleMutex);
+        idle.wait(lock, [&] { return live.load() == 0; });
+    }
+
+    // Awaitable that resumes the coroutine on the same worker after delay.
+    struct Sleep {
+        Clock::duration delay;
+
+        bool await_ready() const { return delay <= Clock::duration::zero(); }
+        void await_suspend(std::coroutine_handle<> handle) const {
+            currentWorker->timers.push(Timer{ Clock::now() + delay, handle });
+        }
+        void await_resume() const {}
+    };
+
+    static Sleep sleepFor(Clock::duration delay) { return Sleep{ delay }; }
+
+    static void finished() {
+        CoroutineScheduler* scheduler = currentScheduler;
+        if (scheduler->live.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(scheduler->idleMutex);
+            scheduler->idle.notify_all();
+        }
+    }
+};
+
+thread_local CoroutineScheduler* CoroutineScheduler::currentScheduler = nullptr;
+thread_local CoroutineScheduler::Worker* CoroutineScheduler::currentWorker = nullptr;
+
+void FightTask::promise_type::FinalAwaiter::await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+    handle.destroy();
+    CoroutineScheduler::finished();
+}
+
+FightTask fightCoroutine(Hero hero, Monster monster, uint64_t fightNumber,
+    std::chrono::milliseconds roundDelay, int& heroHP) {
+    Fight fight(hero, monster, fightNumber);
+    while (fight.round()) {
+        co_await CoroutineScheduler::sleepFor(roundDelay);
+    }
+    heroHP = hero.getHP();
+}
+
+// Game ticks for coroutine fights. A fight awaits next() before each round; release()
+// resumes every waiting fight on the scheduler and returns once each has played its
+// round and is waiting again or has left, so a tick's rounds finish inside the tick as
+// they do on the thread pool. After close() next() resumes with false.
+class TickGate {
+private:
+    std::mutex mutex;
+    std::condition_variable settled;
+    std::vector<std::coroutine_handle<>> waiting;
+    size_t running = 0; // fights expected to reach next() or leave
+    bool closed = false;
+
+    void arrived() {
+        if (--running == 0) {
+            settled.notify_all();
         }
+    }
+
+    void resumeAll(CoroutineScheduler& scheduler, std::unique_lock<std::mutex>& lock) {
+        settled.wait(lock, [&] { return running == 0; });
+        std::vector<std::coroutine_handle<>> batch;
+        batch.swap(waiting);
+        running = batch.size();
+        lock.unlock();
+        for (std::coroutine_handle<> handle : batch) {
+            scheduler.resume(handle);
+        }
+        lock.lock();
+        settled.wait(lock, [&] { return running == 0; });
+    }
+
+public:
+    struct Next {
+        TickGate& gate;
+
+        bool await_ready() const { return false; }
+        void await_suspend(std::coroutine_handle<> handle) const {
+            std::lock_guard<std::mutex> lock(gate.mutex);
+            gate.waiting.push_back(handle);
+            gate.arrived();
+        }
+        bool await_resume() const {
+            std::lock_guard<std::mutex> lock(gate.mutex);
+            return !gate.closed;
+        }
+    };
+
+    Next next() { return Next{ *this }; }
+
+    // Announces a fight about to be spawned, so release() waits for it to arrive.
+    void expect() {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++running;
+    }
+
+    // Called by a fight that will not await next() again.
+    void leave() {
+        std::lock_guard<std::mutex> lock(mutex);
+        arrived();
+    }
+
+    void release(CoroutineScheduler& scheduler) {
+        std::unique_lock<std::mutex> lock(mutex);
+        resumeAll(scheduler, lock);
+    }
+
+    // Lets every waiting fight leave without playing another round.
+    void close(CoroutineScheduler& scheduler) {
+        std::unique_lock<std::mutex> lock(mutex);
+        closed = true;
+        resumeAll(scheduler, lock);
+    }
+};
 
-        monster.attack(hero);
-        if (!hero.isAlive()) {
-            std::cout << hero.getName() << " defeated!\n";
+// Coroutine version of a game fight: one round per tick, done is set once it is over.
+FightTask gameFight(Fight& fight, TickGate& ticks, std::atomic<bool>& done) {
+    while (true) {
+        // Not in the loop condition: GCC 12 skips the suspension of a co_await there.
+        bool open = co_await ticks.next();
+        if (!open) {
             break;
         }
+        if (!fight.round()) {
+            done = true;
+            break;
+        }
+    }
+    ticks.leave();
+}
+
+// "coro [fights] [threads] [roundDelayMs]": all fights start at once as coroutines and
+// sleep roundDelay between rounds like the real-time game, on a handful of threads.
+// Outcomes are checked against a sequential run with the same fight numbers.
+int runCoroutineFights(uint64_t fightCount, unsigned threads, std::chrono::milliseconds roundDelay) {
+    std::vector<int> heroHP(fightCount);
+    console().mute(true);
+    auto start = std::chrono::steady_clock::now();
+    {
+        CoroutineScheduler scheduler(threads);
+        for (uint64_t i = 0; i < fightCount; ++i) {
+            scheduler.spawn(fightCoroutine(Hero("Knight_" + std::to_string(i + 1), 80, 25),
+                Monster("Goblin_" + std::to_string(i + 1), 50, 25), i + 1, roundDelay, heroHP[i]));
+        }
+        scheduler.wait();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t mismatches = 0;
+    for (uint64_t i = 0; i < fightCount; ++i) {
+        Hero hero("Knight_" + std::to_string(i + 1), 80, 25);
+        Monster monster("Goblin_" + std::to_string(i + 1), 50, 25);
+        fight(hero, monster, i + 1, std::chrono::milliseconds(0));
+        mismatches += hero.getHP() != heroHP[i];
+    }
+    console().mute(false);
+
+    say(fightCount, " fights on ", threads, " threads with ", roundDelay.count(), " ms rounds in ", seconds, " s\n");
+    say("Peak fights in flight: ", FightTask::promise_type::peakFrames.load(), ", ",
+        FightTask::promise_type::frameBytes.load(), " bytes per suspended fight\n");
+    say(mismatches, " differ from the sequential run\n");
+    return mismatches == 0 ? 0 : 1;
+}
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+// "stress [fights] [threads]": many fights on many workers compete for a few shared
+// heroes, without round pacing and with console output muted. A fight claims an idle
+// hero through HeroSlot::busy and fights only if the hero is still alive; each hero
+// notes the fights it took part in. The test fails if a claim ever finds the hero
+// already owned, if a flag is left set, or if replaying a hero's fights in order on a
+// fresh hero does not end at the same HP (fights are seeded by their number).
+int runStressTest(uint64_t fightCount, unsigned threads) {
+    // Heroes hit harder and goblins softer than in the game, so most fights are won and
+    // the heroes stay in contention for the whole run.
+    const size_t kHeroes = 4;
+    struct SharedHero {
+        HeroSlot slot;
+        std::atomic<int> owners{ 0 };
+        std::vector<uint64_t> fought; // touched only by the owner of slot
+
+        explicit SharedHero(const std::string& name) : slot(name, 80, 30) {}
+    };
+    std::deque<SharedHero> heroes;
+    for (size_t h = 0; h < kHeroes; ++h) {
+        heroes.emplace_back("Knight_" + std::to_string(h + 1));
+    }
+    std::atomic<uint64_t> doubleClaims{ 0 };
+    std::atomic<uint64_t> unfought{ 0 };
+
+    console().mute(true);
+    auto start = std::chrono::steady_clock::now();
+    {
+        ThreadPool pool(threads);
+        for (uint64_t i = 0; i < fightCount; ++i) {
+            pool.submit([&, i] {
+                while (true) {
+                    bool anyoneLeft = false;
+                    for (size_t k = 0; k < kHeroes; ++k) {
+                        SharedHero& shared = heroes[(i + k) % kHeroes];
+                        bool idle = false;
+                        if (!shared.slot.busy.compare_exchange_strong(idle, true, std::memory_order_acquire)) {
+                            anyoneLeft = true;
+                            continue;
+                        }
+                        if (shared.owners.fetch_add(1) != 0) {
+                            ++doubleClaims;
+                        }
+                        bool alive = shared.slot.hero.isAlive();
+                        if (alive) {
+                            Monster monster("Goblin_" + std::to_string(i + 1), 50, 10);
+                            fight(shared.slot.hero, monster, i + 1, std::chrono::milliseconds(0));
+                            shared.fought.push_back(i + 1);
+                        }
+                        shared.owners.fetch_sub(1);
+                        shared.slot.busy.store(false, std::memory_order_release);
+                        if (alive) {
+                            return;
+                        }
+                    }
+                    if (!anyoneLeft) {
+                        ++unfought; // every hero is dead
+                        return;
+                    }
+                    std::this_thread::yield();
+                }
+            });
+        }
+        pool.wait();
     }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-    if (hero.isAlive()) {
-        hero.heal(15);
+    uint64_t fought = 0;
+    uint64_t mismatches = 0;
+    bool flagsClear = true;
+    for (const SharedHero& shared : heroes) {
+        Hero replay(shared.slot.hero.getName(), 80, 30);
+        for (uint64_t fightNumber : shared.fought) {
+            Monster monster("Goblin_" + std::to_string(fightNumber), 50, 10);
+            fight(replay, monster, fightNumber, std::chrono::milliseconds(0));
+        }
+        mismatches += replay.getHP() != shared.slot.hero.getHP();
+        fought += shared.fought.size();
+        flagsClear = flagsClear && !shared.slot.busy.load();
     }
+    console().mute(false);
+
+    bool ok = doubleClaims == 0 && flagsClear && mismatches == 0 && fought + unfought == fightCount;
+    say(fightCount, " fights for ", kHeroes, " shared heroes on ", threads, " threads in ", seconds, " s: ",
+        fought, " fought, ", unfought.load(), " found no living hero, ", doubleClaims.load(), " double claims, ",
+        mismatches, " heroes differ from a sequential replay", flagsClear ? "" : ", busy flags left set", "\n");
+    return ok ? 0 : 1;
 }
 
-int main() {
-    Hero hero("Knight", 80, 25);
+// The arena, driven by a SimulationClock with 500 ms ticks: a monster spawns every 2 s,
+// idle heroes are matched with monsters every 1 s, and every running fight plays one
+// round per tick. Rounds of one tick run in parallel on the pool; everything else runs
+// between ticks, so the game is the same in real-time and fast-forward mode (only the
+// order of lines printed by simultaneous fights may differ).
+// With coroutines every fight instead runs as a FightTask on the scheduler and waits on
+// a TickGate, which the tick loop releases where the pool would run the rounds, so both
+// modes play the same game. Fights still running when the game stops are left
+// unfinished in both modes.
+int runGame(int heroCount, bool realTime, uint64_t maxTicks, bool coroutines) {
+    std::deque<HeroSlot> heroes;
+    for (int i = 0; i < heroCount; ++i) {
+        heroes.emplace_back(heroCount == 1 ? "Knight" : "Knight_" + std::to_string(i + 1), 80, 25);
+    }
+
+    struct ActiveFight {
+        HeroSlot& slot;
+        Monster monster;
+        Fight fight;
+        std::atomic<bool> done{ false };
+
+        ActiveFight(HeroSlot& slot, Monster&& monster, uint64_t fightNumber)
+            : slot(slot), monster(std::move(monster)), fight(slot.hero, this->monster, fightNumber) {}
+    };
+    std::vector<std::unique_ptr<ActiveFight>> active;
+
+    SimulationClock clock(std::chrono::milliseconds(500), realTime);
+    const uint64_t spawnEvery = clock.ticksIn(std::chrono::seconds(2));
+    const uint64_t dispatchEvery = clock.ticksIn(std::chrono::seconds(1));
+    std::optional<ThreadPool> pool;
+    std::optional<CoroutineScheduler> scheduler;
+    TickGate ticks;
+    if (coroutines) {
+        scheduler.emplace(std::thread::hardware_concurrency());
+    }
+    else {
+        pool.emplace(std::thread::hardware_concurrency());
+    }
+    FastRandom generatorRandom(gameSeed, 0);
+    int heroesAlive = heroCount;
+    uint64_t fights = 0;
+
+    while (heroesAlive > 0 && clock.now() < maxTicks) {
+        uint64_t tick = clock.advance();
+
+        if (tick % spawnEvery == 0) {
+            if (monsters.tryPush(Monster("Goblin_" + std::to_string(generatorRandom.below(100)), 50, 25))) {
+                say("New monster generated!\n");
+            }
+        }
 
-    std::thread monsterGenerator(generateMonsters);
-    monsterGenerator.detach();
+        if (tick % dispatchEvery == 0) {
+            std::vector<HeroSlot*> idleHeroes;
+            for (HeroSlot& slot : heroes) {
+                if (!slot.busy && slot.hero.isAlive()) {
+                    idleHeroes.push_back(&slot);
+                }
+            }
+            std::vector<Monster> batch;
+            monsters.tryPopBatch(batch, idleHeroes.size());
+            for (size_t i = 0; i < batch.size(); ++i) {
+                idleHeroes[i]->busy = true;
+                active.push_back(std::make_unique<ActiveFight>(*idleHeroes[i], std::move(batch[i]), ++fights));
+                if (scheduler) {
+                    ticks.expect();
+                    scheduler->spawn(gameFight(active.back()->fight, ticks, active.back()->done));
+                }
+            }
+        }
 
-    while (hero.isAlive()) {
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        if (pool) {
+            for (auto& current : active) {
+                pool->submit([&current = *current] { current.done = !current.fight.round(); });
+            }
+            pool->wait();
+        }
+        else {
+            ticks.release(*scheduler);
+        }
 
-        std::lock_guard<std::mutex> lock(monstersMutex);
-        if (!monsters.empty()) {
-            Monster currentMonster = monsters[0];
-            monsters.erase(monsters.begin());
-            std::thread fightThread(fight, std::ref(hero), std::ref(currentMonster));
-            fightThread.join();
-            std::cout << "\nHero indicators:\n";
-            hero.displayInfo();
+        for (auto& current : active) {
+            if (current->done) {
+                say("\nHero indicators:\n");
+                current->slot.hero.displayInfo();
+                if (!current->slot.hero.isAlive()) {
+                    --heroesAlive;
+                }
+                current->slot.busy = false;
+            }
         }
+        active.erase(std::remove_if(active.begin(), active.end(),
+            [](const std::unique_ptr<ActiveFight>& current) { return current->done.load(); }), active.end());
+    }
+    if (scheduler) {
+        ticks.close(*scheduler);
+        scheduler->wait();
+    }
+
+    if (heroesAlive == 0) {
+        say("Game Over!\n");
+    }
+    say("Stopped at tick ", clock.now(), " (", clock.gameSeconds(), " s of game time) after ", fights, " fights\n");
+    for (const HeroSlot& slot : heroes) {
+        slot.hero.displayInfo();
     }
-    std::cout << "Game Over!\n";
     return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "bench") {
+        uint64_t fightCount = argc > 2 ? std::stoull(argv[2]) : 1000000;
+        unsigned maxThreads = argc > 3 ? std::stoul(argv[3]) : std::max(std::thread::hardware_concurrency(), 1u);
+        return runBenchmark(fightCount, maxThreads);
+    }
+    if (argc > 1 && std::string(argv[1]) == "bench-queue") {
+        int producers = argc > 2 ? std::stoi(argv[2]) : 2;
+        int consumers = argc > 3 ? std::stoi(argv[3]) : 2;
+        uint64_t count = argc > 4 ? std::stoull(argv[4]) : 1000000;
+        return runQueueBenchmark(producers, consumers, count);
+    }
+    if (argc > 1 && std::string(argv[1]) == "coro") {
+        uint64_t fightCount = argc > 2 ? std::stoull(argv[2]) : 200000;
+        unsigned threads = argc > 3 ? std::stoul(argv[3]) : 4;
+        auto roundDelay = std::chrono::milliseconds(argc > 4 ? std::stoll(argv[4]) : 500);
+        return runCoroutineFights(fightCount, threads, roundDelay);
+    }
+    if (argc > 1 && std::string(argv[1]) == "stress") {
+        uint64_t fightCount = argc > 2 ? std::stoull(argv[2]) : 5000;
+        unsigned threads = argc > 3 ? std::stoul(argv[3]) : 64;
+        return runStressTest(fightCount, threads);
+    }
+    // 7_2 [heroes] [realtime|fast] [maxTicks] [seed] [pool|coro]
+    int heroCount = argc > 1 ? std::stoi(argv[1]) : 1;
+    bool realTime = argc > 2 ? std::string(argv[2]) != "fast" : true;
+    uint64_t maxTicks = argc > 3 ? std::stoull(argv[3]) : UINT64_MAX;
+    if (argc > 4) {
+        gameSeed = std::stoull(argv[4]);
+    }
+    bool coroutines = argc > 5 && std::string(argv[5]) == "coro";
+    return runGame(heroCount, realTime, maxTicks, coroutines);
 }
\ No newline at end of file
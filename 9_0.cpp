@@ -5,33 +5,225 @@
 #include <vector>
 #include <ctime>
 #include <array>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include <thread>
+#include <random>
+#include <optional>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <cctype>
+#include <string_view>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 class Character;
 
-template<typename T>
-class Logger {
+enum class LogLevel { Trace, Debug, Info, Warning, Error, Off };
+
+// Calls below this level are discarded at compile time, message construction included.
+constexpr LogLevel kCompiledLogLevel = LogLevel::Debug;
+
+inline std::atomic<LogLevel> runtimeLogLevel{ LogLevel::Trace };
+
+inline void setRuntimeLogLevel(LogLevel level) { runtimeLogLevel.store(level, std::memory_order_relaxed); }
+
+inline const char* logLevelName(LogLevel level) {
+    switch (level) {
+    case LogLevel::Trace: return "TRACE";
+    case LogLevel::Debug: return "DEBUG";
+    case LogLevel::Info: return "INFO";
+    case LogLevel::Warning: return "WARNING";
+    case LogLevel::Error: return "ERROR";
+    default: return "OFF";
+    }
+}
+
+inline std::string formatCount(unsigned long long value) {
+    std::string digits = std::to_string(value);
+    std::string result;
+    for (size_t i = 0; i < digits.size(); ++i) {
+        if (i > 0 && (digits.size() - i) % 3 == 0) {
+            result += ',';
+        }
+        result += digits[i];
+    }
+    return result;
+}
+
+// Per-call-site suppression state: a token bucket (kept as a GCRA deadline so a single
+// CAS updates it) plus 1-in-N sampling. admit() never blocks.
+class LogSite {
 private:
-    std::ofstream log_file;
+    std::atomic<long long> nextAllowed{ 0 };
+    std::atomic<unsigned long long> calls{ 0 };
+    std::atomic<unsigned long long> suppressed{ 0 };
+    std::atomic<bool> registered{ false };
+    long long interval;
+    long long burstWindow;
+    unsigned sampleEvery;
+
+    static long long nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    bool takeToken() {
+        if (interval == 0) {
+            return true;
+        }
+        long long now = nowNs();
+        long long deadline = nextAllowed.load(std::memory_order_relaxed);
+        while (true) {
+            long long next = std::max(deadline, now) + interval;
+            if (next - now > burstWindow) {
+                return false;
+            }
+            if (nextAllowed.compare_exchange_weak(deadline, next, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+    }
+
+public:
+    // perSecond == 0 disables rate limiting, sampleEvery == 1 disables sampling.
+    LogSite(double perSecond = 0, int burst = 1, unsigned sampleEvery = 1)
+        : interval(perSecond > 0 ? static_cast<long long>(1e9 / perSecond) : 0),
+          burstWindow(interval * std::max(burst, 1)),
+          sampleEvery(std::max(sampleEvery, 1u)) {}
+
+    // Returns true if the message should be written; suppressedBefore receives the number
+    // of messages dropped at this site, sampled out or over the rate, since the last one
+    // that was written.
+    bool admit(unsigned long long& suppressedBefore) {
+        if (sampleEvery > 1 && calls.fetch_add(1, std::memory_order_relaxed) % sampleEvery != 0) {
+            suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (!takeToken()) {
+            suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        suppressedBefore = suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Messages dropped since the last written one; the count is handed over only once.
+    unsigned long long takePending() { return suppressed.exchange(0, std::memory_order_relaxed); }
+
+    // True exactly once, for the first caller after a drop that should register the site.
+    bool claimRegistration() {
+        return !registered.load(std::memory_order_relaxed) && !registered.exchange(true, std::memory_order_relaxed);
+    }
+};
+
+inline std::string logTimestamp() {
+    std::time_t now = std::time(nullptr);
+    std::array<char, 26> time_buf;
+    errno_t err = ctime_s(time_buf.data(), time_buf.size(), &now);
+
+    if (err != 0) {
+        std::cerr << "Error in ctime_s: " << err << std::endl;
+        return "Error";
+    }
+
+    std::string time(time_buf.data());
+    if (!time.empty() && time.back() == '\n') {
+        time.pop_back();
+    }
+    return time;
+}
+
+// Every call site that has dropped a message, with the log file and level of its first
+// drop. A site is shared by all loggers that use it, so the messages dropped after its
+// last written one are reported once, here, when the process exits.
+class ThrottledLogSites {
+private:
+    struct Entry {
+        LogSite* site;
+        std::string fileName;
+        LogLevel level;
+    };
+
+    std::mutex mutex;
+    std::vector<Entry> entries;
 
-    std::string getTimes() const {
-        std::time_t now = std::time(nullptr);
-        std::array<char, 26> time_buf;
-        errno_t err = ctime_s(time_buf.data(), time_buf.size(), &now);
+public:
+    void add(LogSite& site, const std::string& fileName, LogLevel level) {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.push_back(Entry{ &site, fileName, level });
+    }
 
-        if (err != 0) {
-            std::cerr << "Error in ctime_s: " << err << std::endl;
-            return "Error";
+    ~ThrottledLogSites() {
+        for (const Entry& entry : entries) {
+            if (unsigned long long pending = entry.site->takePending(); pending > 0) {
+                std::ofstream out(entry.fileName, std::ios::app);
+                out << "[" << logTimestamp() << "] [" << logLevelName(entry.level) << "] suppressed "
+                    << formatCount(pending) << " similar messages\n";
+            }
         }
+    }
+};
+
+// Constructed on the first drop, after the function-local sites it lists, so it is
+// destroyed before them.
+inline ThrottledLogSites& throttledLogSites() {
+    static ThrottledLogSites sites;
+    return sites;
+}
+
+constexpr double kCombatLogRate = 20.0;
+constexpr int kCombatLogBurst = 50;
+constexpr unsigned kNoEffectLogSample = 10; // blocked attacks repeat the same line
+
+template<typename T, LogLevel MinLevel = kCompiledLogLevel>
+class Logger {
+private:
+    std::ofstream log_file;
+    std::mutex write_mutex;
+    std::string file_name;
 
-        std::string time(time_buf.data());
-        if (!time.empty() && time.back() == '\n') {
-            time.pop_back();
+    template<typename M>
+    void write(LogLevel level, const M& message) {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        if (!log_file.is_open()) {
+            throw std::runtime_error("Log file is not open");
         }
-        return time;
+        log_file << "[" << logTimestamp() << "] [" << logLevelName(level) << "] " << message << "\n";
+        log_file.flush();
     }
 
 public:
-    Logger(const std::string& filename) {
+    static constexpr bool compiledIn(LogLevel level) {
+        return MinLevel != LogLevel::Off && level != LogLevel::Off && level >= MinLevel;
+    }
+
+    static bool enabled(LogLevel level) {
+        return compiledIn(level) && level >= runtimeLogLevel.load(std::memory_order_relaxed);
+    }
+
+    Logger(const std::string& filename) : file_name(filename) {
+        if constexpr (MinLevel == LogLevel::Off) {
+            return;
+        }
         log_file.open(filename, std::ios::app);
         if (!log_file.is_open()) {
             throw std::runtime_error("Failed to open log file: " + filename);
@@ -39,11 +231,38 @@ public:
     }
 
     void log(const T& message) {
-        if (!log_file.is_open()) {
-            throw std::runtime_error("Log file is not open");
+        log<LogLevel::Info>([&]() -> const T& { return message; });
+    }
+
+    // The message is built by makeMessage only when Level passes both filters.
+    template<LogLevel Level, typename F>
+    void log(F&& makeMessage) {
+        if constexpr (compiledIn(Level)) {
+            if (Level >= runtimeLogLevel.load(std::memory_order_relaxed)) {
+                write(Level, makeMessage());
+            }
+        }
+    }
+
+    // Same as above, but subject to the rate limit and sampling of the given call site.
+    template<LogLevel Level, typename F>
+    void log(LogSite& site, F&& makeMessage) {
+        if constexpr (compiledIn(Level)) {
+            if (Level < runtimeLogLevel.load(std::memory_order_relaxed)) {
+                return;
+            }
+            unsigned long long suppressedBefore = 0;
+            if (!site.admit(suppressedBefore)) {
+                if (site.claimRegistration()) {
+                    throttledLogSites().add(site, file_name, Level);
+                }
+                return;
+            }
+            if (suppressedBefore > 0) {
+                write(Level, "suppressed " + formatCount(suppressedBefore) + " similar messages");
+            }
+            write(Level, makeMessage());
         }
-        log_file << "[" << getTimes() << "] " << message << "\n";
-        log_file.flush();
     }
 
     ~Logger() {
@@ -53,56 +272,328 @@ public:
     }
 };
 
-class Item {
-protected:
+// Advances a splitmix64 state and returns its next output; used to expand seeds.
+inline uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// xoshiro256** generator. Every thread owns one (see gameRandom), so combat rolls need no
+// locking and a (seed, stream) pair reproduces a thread's rolls exactly.
+class FastRandom {
+private:
+    std::array<uint64_t, 4> state;
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+public:
+    explicit FastRandom(uint64_t seed = 0, uint64_t stream = 0) { reseed(seed, stream); }
+
+    void reseed(uint64_t seed, uint64_t stream = 0) {
+        uint64_t mix = seed ^ (stream * 0xD1B54A32D192ED03ull);
+        for (uint64_t& word : state) {
+            word = splitmix64(mix);
+        }
+    }
+
+    uint64_t next() {
+        const uint64_t result = rotl(state[1] * 5, 7) * 9;
+        const uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
+    }
+
+    // Unbiased draw from [0, bound) by Lemire's multiply-and-reject.
+    uint32_t below(uint32_t bound) {
+        uint64_t m = (next() >> 32) * bound;
+        if (static_cast<uint32_t>(m) < bound) {
+            const uint32_t threshold = (0u - bound) % bound;
+            while (static_cast<uint32_t>(m) < threshold) {
+                m = (next() >> 32) * bound;
+            }
+        }
+        return static_cast<uint32_t>(m >> 32);
+    }
+};
+
+// This thread's generator. Unseeded threads start from std::random_device.
+inline FastRandom& gameRandom() {
+    thread_local FastRandom random(std::random_device{}());
+    return random;
+}
+
+inline void seedGameRandom(uint64_t seed, uint64_t stream = 0) { gameRandom().reseed(seed, stream); }
+
+using ItemId = uint8_t;
+
+enum class ItemEffect : uint8_t { RaiseAttack, Heal };
+constexpr size_t kItemEffects = 2;
+
+// Everything that tells one item kind from another, stored once per kind and shared by
+// every stack of it.
+struct ItemDefinition {
     std::string name;
+    ItemEffect effect;
+    int amount;
+    int limit; // Heal: health is capped here
+};
+
+class ItemCatalog {
+private:
+    std::vector<ItemDefinition> definitions;
+    std::unordered_map<std::string, ItemId> idsByName;
+
+public:
+    ItemId add(const ItemDefinition& definition) {
+        if (definitions.size() > std::numeric_limits<ItemId>::max()) {
+            throw std::runtime_error("Too many item kinds");
+        }
+        ItemId id = static_cast<ItemId>(definitions.size());
+        if (!idsByName.emplace(definition.name, id).second) {
+            throw std::invalid_argument("Duplicate item name: " + definition.name);
+        }
+        definitions.push_back(definition);
+        return id;
+    }
+
+    std::optional<ItemId> find(const std::string& name) const {
+        auto it = idsByName.find(name);
+        return it == idsByName.end() ? std::nullopt : std::optional<ItemId>(it->second);
+    }
+
+    static ItemCatalog defaults() {
+        ItemCatalog catalog;
+        catalog.add({ "Grindstone", ItemEffect::RaiseAttack, 1, 0 });
+        catalog.add({ "Potion", ItemEffect::Heal, 25, 100 });
+        return catalog;
+    }
+
+    size_t size() const { return definitions.size(); }
+    const ItemDefinition& operator[](ItemId id) const { return definitions.at(id); }
+};
+
+// Ids of ItemCatalog::defaults().
+constexpr ItemId kGrindstone = 0;
+constexpr ItemId kPotion = 1;
+
+inline const ItemCatalog& itemCatalog() {
+    static const ItemCatalog catalog = ItemCatalog::defaults();
+    return catalog;
+}
+
+void applyItem(const ItemDefinition& definition, Character& hero);
+
+// Packed values with stable handles. Values stay contiguous for iteration and removal
+// moves the last value into the hole, so add, remove and lookup are O(1). A handle names
+// a slot plus the generation it was issued for; removing bumps the generation, so a
+// handle to a removed value is reported as stale instead of reaching whatever reuses
+// the slot.
+template<typename T>
+class SlotMap {
 public:
-    Item(const std::string& n) : name(n) {}
+    struct Handle {
+        uint32_t slot = UINT32_MAX;
+        uint32_t generation = 0;
 
-    std::string getName() const { return name; }
+        bool operator==(const Handle& other) const { return slot == other.slot && generation == other.generation; }
+    };
+
+private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    struct Slot {
+        uint32_t dense;      // index into values, or the next free slot while free
+        uint32_t generation;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<T> values;
+    std::vector<uint32_t> owners; // owners[i] is the slot of values[i]
+    uint32_t freeHead = kNone;
+
+public:
+    size_t size() const { return values.size(); }
+    bool empty() const { return values.empty(); }
+
+    Handle insert(T value) {
+        uint32_t slot = freeHead;
+        if (slot != kNone) {
+            freeHead = slots[slot].dense;
+        }
+        else {
+            slot = static_cast<uint32_t>(slots.size());
+            slots.push_back(Slot{ kNone, 0 });
+        }
+        values.push_back(std::move(value));
+        owners.push_back(slot);
+        slots[slot].dense = static_cast<uint32_t>(values.size() - 1);
+        return Handle{ slot, slots[slot].generation };
+    }
+
+    bool contains(Handle handle) const {
+        return handle.slot < slots.size() && slots[handle.slot].generation == handle.generation;
+    }
+
+    T* get(Handle handle) {
+        return contains(handle) ? &values[slots[handle.slot].dense] : nullptr;
+    }
+
+    const T* get(Handle handle) const {
+        return contains(handle) ? &values[slots[handle.slot].dense] : nullptr;
+    }
+
+    bool erase(Handle handle) {
+        if (!contains(handle)) {
+            return false;
+        }
+        uint32_t hole = slots[handle.slot].dense;
+        uint32_t last = static_cast<uint32_t>(values.size() - 1);
+        if (hole != last) {
+            values[hole] = std::move(values[last]);
+            owners[hole] = owners[last];
+            slots[owners[hole]].dense = hole;
+        }
+        values.pop_back();
+        owners.pop_back();
+        ++slots[handle.slot].generation;
+        slots[handle.slot].dense = freeHead;
+        freeHead = handle.slot;
+        return true;
+    }
+
+    // Handle of the value at position index of the packed order (as iterated).
+    Handle handleAt(size_t index) const {
+        return Handle{ owners[index], slots[owners[index]].generation };
+    }
 
-    virtual void use(Character& hero) {};
+    typename std::vector<T>::iterator begin() { return values.begin(); }
+    typename std::vector<T>::iterator end() { return values.end(); }
+    typename std::vector<T>::const_iterator begin() const { return values.begin(); }
+    typename std::vector<T>::const_iterator end() const { return values.end(); }
+};
 
-    virtual ~Item() = default;
+// All items of one kind the hero carries.
+struct ItemStack {
+    ItemId id;
+    uint32_t count;
+    uint32_t effectPosition = 0; // in Inventory's list of stacks with the same effect
 };
 
 class Inventory {
+public:
+    using Handle = SlotMap<ItemStack>::Handle;
+
 private:
-    std::vector<std::unique_ptr<Item>> items;
+    SlotMap<ItemStack> stacks;
+    std::vector<Handle> stackOf; // by ItemId
+    std::array<std::vector<Handle>, kItemEffects> stacksByEffect; // unordered, swap-removed
+    std::array<uint32_t, kItemEffects> countByEffect{};
     Logger<std::string> logger;
+
+    const std::string& nameOf(const ItemStack& stack) const { return itemCatalog()[stack.id].name; }
+    static size_t effectOf(ItemId id) { return static_cast<size_t>(itemCatalog()[id].effect); }
+
 public:
     Inventory() : logger("inventory_log.txt") {}
 
-    size_t size() const { return items.size(); }
+    // Number of stacks, as listed by display().
+    size_t size() const { return stacks.size(); }
+
+    uint32_t count(ItemId id) const {
+        const ItemStack* stack = id < stackOf.size() ? stacks.get(stackOf[id]) : nullptr;
+        return stack ? stack->count : 0;
+    }
+
+    uint32_t count(const std::string& name) const {
+        std::optional<ItemId> id = itemCatalog().find(name);
+        return id ? count(*id) : 0;
+    }
+
+    uint32_t count(ItemEffect effect) const { return countByEffect[static_cast<size_t>(effect)]; }
+
+    // Stack holding items of this name or effect; a stale handle if there is none.
+    Handle firstOf(const std::string& name) const {
+        std::optional<ItemId> id = itemCatalog().find(name);
+        return id && *id < stackOf.size() ? stackOf[*id] : Handle();
+    }
+
+    Handle firstOf(ItemEffect effect) const {
+        const std::vector<Handle>& list = stacksByEffect[static_cast<size_t>(effect)];
+        return list.empty() ? Handle() : list.front();
+    }
+
+    // Handle of the stack shown as number index + 1 by display(). Any removal can
+    // renumber the list, so resolve numbers right before use.
+    Handle handleAt(size_t index) const { return stacks.handleAt(index); }
 
-    void addItem(std::unique_ptr<Item> item) {
-        items.push_back(std::move(item));
-        logger.log("Added item: " + items.back()->getName());
+    Handle addItem(ItemId id, uint32_t count = 1) {
+        if (id >= stackOf.size()) {
+            stackOf.resize(itemCatalog().size());
+        }
+        ItemStack* stack = stacks.get(stackOf[id]);
+        if (stack != nullptr) {
+            stack->count += count;
+        }
+        else {
+            std::vector<Handle>& list = stacksByEffect[effectOf(id)];
+            stackOf[id] = stacks.insert(ItemStack{ id, count, static_cast<uint32_t>(list.size()) });
+            list.push_back(stackOf[id]);
+        }
+        countByEffect[effectOf(id)] += count;
+        logger.log<LogLevel::Debug>([&] { return "Added item: " + itemCatalog()[id].name; });
+        return stackOf[id];
     }
 
-    void removeItem(int index) {
-        if (index >= 0 && index < items.size()) {
-            logger.log("Removed item: " + items[index]->getName());
-            items.erase(items.begin() + index);
+    // Takes one item off the stack; false if the handle is stale.
+    bool removeItem(Handle handle) {
+        ItemStack* stack = stacks.get(handle);
+        if (stack == nullptr) {
+            return false;
+        }
+        logger.log<LogLevel::Debug>([&] { return "Removed item: " + nameOf(*stack); });
+        size_t effect = effectOf(stack->id);
+        --countByEffect[effect];
+        if (--stack->count == 0) {
+            std::vector<Handle>& list = stacksByEffect[effect];
+            list[stack->effectPosition] = list.back();
+            stacks.get(list.back())->effectPosition = stack->effectPosition;
+            list.pop_back();
+            stacks.erase(handle);
         }
+        return true;
     }
 
-    void useItem(int index, Character& character) {
-        if (index >= 0 && index < items.size()) {
-            items[index]->use(character);
-            logger.log("Using item: " + items[index]->getName());
-            removeItem(index);
+    // Uses one item of the stack; false if the handle is stale.
+    bool useItem(Handle handle, Character& character) {
+        ItemStack* stack = stacks.get(handle);
+        if (stack == nullptr) {
+            return false;
         }
+        applyItem(itemCatalog()[stack->id], character);
+        logger.log<LogLevel::Debug>([&] { return "Using item: " + nameOf(*stack); });
+        return removeItem(handle);
     }
 
     void display() const {
         std::cout << "\nInventory:\n";
-        if (items.empty()) {
+        if (stacks.empty()) {
             std::cout << "Empty\n";
             return;
         }
-        for (size_t i = 0; i < items.size(); ++i) {
-            std::cout << i + 1 << ". " << items[i]->getName() << "\n";
+        size_t number = 0;
+        for (const ItemStack& stack : stacks) {
+            std::cout << ++number << ". " << nameOf(stack);
+            if (stack.count > 1) {
+                std::cout << " x" << stack.count;
+            }
+            std::cout << "\n";
         }
     }
 };
@@ -124,6 +615,7 @@ public:
     int getDefense() const { return defense; }
     void setHealth(int newHealth) { health = newHealth; }
     void setAttack(int newAttack) { attack = newAttack; }
+    void setDefense(int newDefense) { defense = newDefense; }
 
     virtual void attackEnemy(Entity& enemy) = 0;
     virtual void displayInfo() const = 0;
@@ -152,11 +644,13 @@ public:
         if (damage > 0) {
             enemy.setHealth(enemy.getHealth() - damage);
             std::cout << name << " attacks " << enemy.getName() << " for " << damage << " damage!" << std::endl;
-            logger.log(name + " attacks " + enemy.getName() + " for " + std::to_string(damage) + " damage!");
+            static LogSite site(kCombatLogRate, kCombatLogBurst);
+            logger.log<LogLevel::Debug>(site, [&] { return name + " attacks " + enemy.getName() + " for " + std::to_string(damage) + " damage!"; });
         }
         else {
             std::cout << name << " attacks " << enemy.getName() << ", but it has no effect!" << std::endl;
-            logger.log(name + " attacks " + enemy.getName() + ", but it has no effect!");
+            static LogSite site(kCombatLogRate, kCombatLogBurst, kNoEffectLogSample);
+            logger.log<LogLevel::Debug>(site, [&] { return name + " attacks " + enemy.getName() + ", but it has no effect!"; });
         }
     }
 
@@ -166,14 +660,12 @@ public:
             << ", Level: " << level << ", Experience: " << experience << std::endl;
     }
 
-    void addToInventory(std::unique_ptr<Item> item) {
-        inventory.addItem(std::move(item));
+    void addToInventory(ItemId id, uint32_t count = 1) {
+        inventory.addItem(id, count);
     }
 
-    void useItem(int index) {
-        if (index >= 0 && index < inventory.size()) {
-            inventory.useItem(index, *this);
-        }
+    void useItem(Inventory::Handle handle) {
+        inventory.useItem(handle, *this);
     }
 
     void showInventory() const {
@@ -192,7 +684,7 @@ public:
             << attack << "\n" << defense << "\n"
             << level << "\n" << experience << "\n";
 
-        logger.log("Game saved for character " + name);
+        logger.log<LogLevel::Info>([&] { return "Game saved for character " + name; });
     }
 
     void loadGame(const std::string& filename) {
@@ -203,226 +695,707 @@ public:
 
         in >> name >> health >> attack >> defense >> level >> experience;
 
-        logger.log("Game loaded for character " + name);
+        logger.log<LogLevel::Info>([&] { return "Game loaded for character " + name; });
     }
 
     ~Character() override {}
 };
 
-class Grindstone : public Item {
-public:
-    Grindstone() : Item("Grindstone") {}
-
-    void use(Character& hero) {
-        hero.setAttack(hero.getAttack() + 1);
-        std::cout << "Use a grindstone!\n" << name << " increase your damage by 1!" << std::endl;
-    }
-
-    ~Grindstone() override {}
-};
-
-class Potion : public Item {
-protected:
-    int treatment;
-public:
-    Potion() : Item("Potion"), treatment(25) {}
-
-    void use(Character& hero) {
-        hero.setHealth(hero.getHealth() + treatment);
-        if (hero.getHealth() > 100) {
-            hero.setHealth(100);
-        }
-        std::cout << "The potion is drunk!\n" << name << " restored " << treatment << " units of health!\n";
+void applyItem(const ItemDefinition& definition, Character& hero) {
+    switch (definition.effect) {
+    case ItemEffect::RaiseAttack:
+        hero.setAttack(hero.getAttack() + definition.amount);
+        std::cout << "Use a grindstone!\n" << definition.name << " increase your damage by " << definition.amount << "!" << std::endl;
+        break;
+    case ItemEffect::Heal:
+        hero.setHealth(std::min(hero.getHealth() + definition.amount, definition.limit));
+        std::cout << "The potion is drunk!\n" << definition.name << " restored " << definition.amount << " units of health!\n";
+        break;
     }
+}
+
+// Inventory that several server threads may use at once. Counts per item kind are
+// atomics, and adding, removing and using are a single CAS or add on one count. The top
+// bit of a count is a trade lock: trade() sets it on the two counts it takes from, in
+// address order, once each holds enough, so a concurrent remove of those kinds waits
+// for the trade instead of draining the items it checked, and two opposite trades
+// cannot deadlock. Adds never wait. Log lines are written after the trade is done.
+class ConcurrentInventory {
+private:
+    static constexpr uint32_t kTradeLock = 0x80000000u;
 
-    ~Potion() override {}
-};
-
-class Monster : public Entity {
-protected:
-    int exp;
+    std::vector<std::atomic<uint32_t>> counts; // by ItemId, kTradeLock set during a trade
+    std::array<std::atomic<uint32_t>, kItemEffects> countByEffect{};
     Logger<std::string> logger;
-public:
-    Monster(const std::string& n, int h, int a, int d, int e)
-        : Entity(n, h, a, d), exp(e), logger("monster_log.txt") {}
-
 
-    void displayInfo() const override {
-        std::cout << "\nMonster Name: " << name << ", HP: " << health
-            << ", Attack: " << attack << ", Defense: " << defense << std::endl;
+    std::atomic<uint32_t>& effectCount(ItemId id) {
+        return countByEffect[static_cast<size_t>(itemCatalog()[id].effect)];
     }
 
-    void gainExp(Character& hero) {
-        hero.setExperience(hero.getExperience() + exp);
-        if (hero.getExperience() >= 100) {
-            hero.setLevel(hero.getLevel() + 1);
-            hero.setExperience(0);
-            hero.setAttack(hero.getAttack() + 1);
-            hero.setHealth(100);
-            std::cout << hero.getName() << " leveled up to level " << hero.getLevel() << "!" << std::endl;
-            logger.log(hero.getName() + " level increased!");
-
-            if (hero.getLevel() % 3 == 0) {
-                hero.addToInventory(std::make_unique<Potion>());
-                std::cout << "Potion added to inventory.\n";
-                logger.log("Potion added to inventory.");
+    // Takes count items of id if there are that many, waiting out a trade that holds them.
+    bool take(ItemId id, uint32_t count) {
+        uint32_t current = counts[id].load(std::memory_order_relaxed);
+        while (true) {
+            if ((current & ~kTradeLock) < count) {
+                return false;
             }
-            else if (hero.getLevel() % 2 == 0) {
-                hero.addToInventory(std::make_unique<Grindstone>());
-                std::cout << "Grindstone added to inventory.\n";
-                logger.log("Grindstone added to inventory.");
+            if (current & kTradeLock) {
+                std::this_thread::yield();
+                current = counts[id].load(std::memory_order_relaxed);
+            }
+            else if (counts[id].compare_exchange_weak(current, current - count, std::memory_order_relaxed)) {
+                break;
             }
         }
+        effectCount(id).fetch_sub(count, std::memory_order_relaxed);
+        return true;
     }
 
-    ~Monster() override {}
-};
-
-class Goblin : public Monster {
-public:
-    Goblin() : Monster("Goblin", 30, 8, 3, 25) {}
+    void give(ItemId id, uint32_t count) {
+        counts[id].fetch_add(count, std::memory_order_relaxed);
+        effectCount(id).fetch_add(count, std::memory_order_relaxed);
+    }
 
-    void attackEnemy(Entity& hero) override {
-        int damage = attack - hero.getDefense();
-        if (damage > 0) {
-            if (rand() % 100 < 50) {
-                hero.setHealth(hero.getHealth() - damage * 2);
-                std::cout << "Stab in the back!\n" << name << " attacks " 
-                    << hero.getName() << " for " << damage * 2 << " damage!" << std::endl;
-                logger.log(name + " attacks " + hero.getName() + " for " + std::to_string(damage * 2) + " damage!");
+    // Sets the trade lock on count once it holds at least needed items; false if it
+    // holds fewer.
+    static bool lockForTrade(std::atomic<uint32_t>& count, uint32_t needed) {
+        uint32_t current = count.load(std::memory_order_relaxed);
+        while (true) {
+            if ((current & ~kTradeLock) < needed) {
+                return false;
             }
-            else {
-                hero.setHealth(hero.getHealth() - damage);
-                std::cout << name << " attacks " << hero.getName() << " for " << damage << " damage!" << std::endl;
-                logger.log(name + " attacks " + hero.getName() + " for " + std::to_string(damage) + " damage!");
+            if (current & kTradeLock) {
+                std::this_thread::yield();
+                current = count.load(std::memory_order_relaxed);
             }
-
-            if (hero.getHealth() <= 0) {
-                throw std::runtime_error(hero.getName() + " was killed, the game is over!");
-                logger.log("Game over! " + name + " killed the hero!");
+            else if (count.compare_exchange_weak(current, current | kTradeLock, std::memory_order_acquire)) {
+                return true;
             }
         }
-        else {
-            std::cout << name << " attacks " << hero.getName() << ", but it has no effect!" << std::endl;
-            logger.log(name + " attacks " + hero.getName() + ", but it has no effect!");
-        }
     }
 
-    ~Goblin() override {}
-};
+    // Takes count items of a kind locked by lockForTrade and clears the lock.
+    void takeLocked(ItemId id, uint32_t count) {
+        counts[id].fetch_sub(kTradeLock + count, std::memory_order_release);
+        effectCount(id).fetch_sub(count, std::memory_order_relaxed);
+    }
 
-class Sceleton : public Monster {
 public:
-    Sceleton() : Monster("Sceleton", 20, 7, 2, 15) {}
+    ConcurrentInventory(const std::string& logFile = "inventory_log.txt")
+        : counts(itemCatalog().size()), logger(logFile) {}
 
-    void attackEnemy(Entity& hero) override {
-        int damage = attack - hero.getDefense();
-        if (damage > 0) {
-            if (rand() % 100 < 30) {
-                hero.setHealth(hero.getHealth() - damage * 3);
-                std::cout << "Critical hit!\n" << name << " attacks "
-                    << hero.getName() << " for " << damage * 3 << " damage!" << std::endl;
-                logger.log(name + " attacks " + hero.getName() + " for " + std::to_string(damage * 3) + " damage!");
-            }
-            else {
-                hero.setHealth(hero.getHealth() - damage);
-                std::cout << name << " attacks " << hero.getName() << " for " << damage << " damage!" << std::endl;
-                logger.log(name + " attacks " + hero.getName() + " for " + std::to_string(damage) + " damage!");
-            }
+    uint32_t count(ItemId id) const {
+        return id < counts.size() ? counts[id].load(std::memory_order_relaxed) & ~kTradeLock : 0;
+    }
 
-            if (hero.getHealth() <= 0) {
-                std::cout << "Game over!\n" << name << " killed the hero!" << std::endl;
-                logger.log("Game over! " + name + " killed the hero!");
-            }
-        }
-        else {
-            throw std::runtime_error(hero.getName() + " was killed, the game is over!");
-            logger.log(name + " attacks " + hero.getName() + ", but it has no effect!");
-        }
+    uint32_t count(ItemEffect effect) const {
+        return countByEffect[static_cast<size_t>(effect)].load(std::memory_order_relaxed);
     }
 
-    ~Sceleton() override {}
-};
+    // False, with nothing added, if id is not in the catalog.
+    bool addItem(ItemId id, uint32_t count = 1) {
+        if (id >= counts.size()) {
+            return false;
+        }
+        give(id, count);
+        logger.log<LogLevel::Debug>([&] { return "Added item: " + itemCatalog()[id].name; });
+        return true;
+    }
 
-class Dragon : public Monster {
-public:
-    Dragon() : Monster("Dragon", 60, 20, 8, 50) {}
+    // Takes one item of this kind; false if there is none or id is not in the catalog.
+    bool removeItem(ItemId id) {
+        bool removed = id < counts.size() && take(id, 1);
+        if (removed) {
+            logger.log<LogLevel::Debug>([&] { return "Removed item: " + itemCatalog()[id].name; });
+        }
+        return removed;
+    }
 
-    void attackEnemy(Entity& hero) override {
-        int damage = attack - hero.getDefense();
-        if (damage > 0) {
-            if (rand() % 100 < 10) {
-                hero.setHealth(hero.getHealth() - damage + 10 );
-                std::cout << "Fireball!\n" << name << " attacks "
-                    << hero.getName() << " for " << damage + 10 << " damage!" << std::endl;
-                logger.log(name + " attacks " + hero.getName() + " for " + std::to_string(damage + 10) + " damage!");
-            }
-            else {
-                hero.setHealth(hero.getHealth() - damage);
-                std::cout << name << " attacks " << hero.getName() << " for " << damage << " damage!" << std::endl;
-                logger.log(name + " attacks " + hero.getName() + " for " + std::to_string(damage) + " damage!");
-            }
+    // Uses one item of this kind; false if there is none. The item is taken first and
+    // applied after, so the hero is the caller's to synchronize.
+    bool useItem(ItemId id, Character& character) {
+        if (!removeItem(id)) {
+            return false;
+        }
+        applyItem(itemCatalog()[id], character);
+        logger.log<LogLevel::Debug>([&] { return "Using item: " + itemCatalog()[id].name; });
+        return true;
+    }
 
-            if (hero.getHealth() <= 0) {
-                std::cout << "Game over!\n" << name << " killed the hero!" << std::endl;
-                logger.log("Game over! " + name + " killed the hero!");
-            }
+    // Atomically moves giveCount items of give from a to b and takeCount items of take
+    // from b to a. Either both transfers happen or, if one side is short, neither does.
+    // The received items are added before the given ones are taken, so a concurrent
+    // reader may briefly see both. An inventory cannot trade with itself, and kinds
+    // outside the catalog are refused.
+    static bool trade(ConcurrentInventory& a, ItemId give, uint32_t giveCount,
+        ConcurrentInventory& b, ItemId take, uint32_t takeCount) {
+        if (&a == &b || give >= a.counts.size() || take >= b.counts.size()) {
+            return false;
         }
-        else {
-            throw std::runtime_error(hero.getName() + " was killed, the game is over!");
-            logger.log(name + " attacks " + hero.getName() + ", but it has no effect!");
+        std::atomic<uint32_t>* fromA = &a.counts[give];
+        std::atomic<uint32_t>* fromB = &b.counts[take];
+        bool aFirst = std::less<std::atomic<uint32_t>*>()(fromA, fromB);
+        std::atomic<uint32_t>& first = aFirst ? *fromA : *fromB;
+        std::atomic<uint32_t>& second = aFirst ? *fromB : *fromA;
+        if (!lockForTrade(first, aFirst ? giveCount : takeCount)) {
+            return false;
+        }
+        if (!lockForTrade(second, aFirst ? takeCount : giveCount)) {
+            first.fetch_sub(kTradeLock, std::memory_order_release);
+            return false;
         }
+        b.give(give, giveCount);
+        a.give(take, takeCount);
+        a.takeLocked(give, giveCount);
+        b.takeLocked(take, takeCount);
+
+        auto describe = [&](ItemId out, uint32_t outCount, ItemId in, uint32_t inCount) {
+            return "Traded " + std::to_string(outCount) + " " + itemCatalog()[out].name + " for "
+                + std::to_string(inCount) + " " + itemCatalog()[in].name;
+        };
+        a.logger.log<LogLevel::Debug>([&] { return describe(give, giveCount, take, takeCount); });
+        b.logger.log<LogLevel::Debug>([&] { return describe(take, takeCount, give, giveCount); });
+        return true;
     }
 
-    ~Dragon() override {}
-};
-
-class Troll : public Monster {
-public:
-    Troll() : Monster("Troll", 40, 14, 1, 30) {}
-
-    void attackEnemy(Entity& hero) override {
-        int damage = attack - hero.getDefense();
-        if (damage > 0) {
-            if (rand() % 100 < 40) {
-                hero.setHealth(hero.getHealth() - damage + 5);
-                std::cout << "Heavy blow!\n" << name << " attacks "
-                    << hero.getName() << " for " << damage + 5 << " damage!" << std::endl;
-                logger.log(name + " attacks " + hero.getName() + " for " + std::to_string(damage + 5) + " damage!");
-            }
-            else {
-                hero.setHealth(hero.getHealth() - damage);
-                std::cout << name << " attacks " << hero.getName() << " for " << damage << " damage!" << std::endl;
-                logger.log(name + " attacks " + hero.getName() + " for " + std::to_string(damage) + " damage!");
-            }
-
-            if (hero.getHealth() <= 0) {
-                std::cout << "Game over!\n" << name << " killed the hero!" << std::endl;
-                logger.log("Game over! " + name + " killed the hero!");
+    // Counts are read one kind at a time, so changes made meanwhile may show for some
+    // kinds and not others.
+    void display() const {
+        std::vector<std::pair<ItemId, uint32_t>> snapshot;
+        for (ItemId id = 0; id < counts.size(); ++id) {
+            if (uint32_t n = count(id); n > 0) {
+                snapshot.emplace_back(id, n);
             }
         }
-        else {
-            throw std::runtime_error(hero.getName() + " was killed, the game is over!");
-            logger.log(name + " attacks " + hero.getName() + ", but it has no effect!");
+        std::cout << "\nInventory:\n";
+        if (snapshot.empty()) {
+            std::cout << "Empty\n";
+            return;
+        }
+        for (size_t i = 0; i < snapshot.size(); ++i) {
+            std::cout << i + 1 << ". " << itemCatalog()[snapshot[i].first].name;
+            if (snapshot[i].second > 1) {
+                std::cout << " x" << snapshot[i].second;
+            }
+            std::cout << "\n";
         }
     }
-
-    ~Troll() override {}
+};
+
+using MonsterId = uint8_t;
+
+enum class CritKind : uint8_t { Multiply, Add };
+
+// Everything that tells one monster type from another.
+struct MonsterSpec {
+    std::string name;
+    int health;
+    int attack;
+    int defense;
+    int exp;
+    int critChance;
+    CritKind critKind;
+    int critValue;
+    int encounterWeight;
+    std::string critMessage;
+};
+
+// Health a target loses from a hit of base damage > 0; instantiated once per modifier kind.
+template<CritKind Kind>
+constexpr int hitDamage(int damage, bool crit, int critValue) {
+    if (!crit) {
+        return damage;
+    }
+    if constexpr (Kind == CritKind::Multiply) {
+        return damage * critValue;
+    }
+    else {
+        return damage + critValue;
+    }
+}
+
+class MonsterCatalog {
+private:
+    std::vector<MonsterSpec> specs;
+    std::vector<uint32_t> weightEnds;
+
+public:
+    void add(const MonsterSpec& spec) {
+        if (specs.size() > std::numeric_limits<MonsterId>::max()) {
+            throw std::runtime_error("Too many monster types");
+        }
+        specs.push_back(spec);
+        weightEnds.push_back(encounterRange() + static_cast<uint32_t>(std::max(spec.encounterWeight, 0)));
+    }
+
+    static MonsterCatalog defaults() {
+        MonsterCatalog catalog;
+        catalog.add({ "Sceleton", 20, 7, 2, 15, 30, CritKind::Multiply, 3, 3, "Critical hit!" });
+        catalog.add({ "Goblin", 30, 8, 3, 25, 50, CritKind::Multiply, 2, 3, "Stab in the back!" });
+        catalog.add({ "Troll", 40, 14, 1, 30, 40, CritKind::Add, 5, 2, "Heavy blow!" });
+        catalog.add({ "Dragon", 60, 20, 8, 50, 10, CritKind::Add, 10, 2, "Fireball!" });
+        return catalog;
+    }
+
+    // One monster per line: name,health,attack,defense,exp,critChance,modifier,weight,message
+    // where modifier is x<factor> or +<bonus>. Lines starting with # are comments.
+    static MonsterCatalog load(const std::string& filename) {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open monster catalog: " + filename);
+        }
+
+        MonsterCatalog catalog;
+        std::string line;
+        while (std::getline(file, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+            std::stringstream ss(line);
+            std::array<std::string, 8> fields;
+            for (std::string& field : fields) {
+                std::getline(ss, field, ',');
+            }
+            MonsterSpec spec;
+            std::getline(ss, spec.critMessage);
+            try {
+                spec.name = fields[0];
+                spec.health = std::stoi(fields[1]);
+                spec.attack = std::stoi(fields[2]);
+                spec.defense = std::stoi(fields[3]);
+                spec.exp = std::stoi(fields[4]);
+                spec.critChance = std::stoi(fields[5]);
+                if (fields[6].size() < 2 || (fields[6][0] != 'x' && fields[6][0] != '+')) {
+                    throw std::invalid_argument("modifier must be x<factor> or +<bonus>");
+                }
+                spec.critKind = fields[6][0] == 'x' ? CritKind::Multiply : CritKind::Add;
+                spec.critValue = std::stoi(fields[6].substr(1));
+                spec.encounterWeight = std::stoi(fields[7]);
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Error reading monster '" << line << "': " << e.what() << std::endl;
+                continue;
+            }
+            catalog.add(spec);
+        }
+        if (catalog.size() == 0 || catalog.encounterRange() == 0) {
+            throw std::runtime_error("Monster catalog has no monsters to encounter: " + filename);
+        }
+        return catalog;
+    }
+
+    size_t size() const { return specs.size(); }
+
+    const MonsterSpec& operator[](MonsterId id) const { return specs[id]; }
+
+    uint32_t encounterRange() const { return weightEnds.empty() ? 0 : weightEnds.back(); }
+
+    // Monster met for a roll in [0, encounterRange()).
+    MonsterId encounter(uint32_t roll) const {
+        return static_cast<MonsterId>(std::upper_bound(weightEnds.begin(), weightEnds.end(), roll) - weightEnds.begin());
+    }
+};
+
+// Monsters keep pointers into the catalog, so replace it only before any are created.
+inline MonsterCatalog& monsterCatalog() {
+    static MonsterCatalog catalog = MonsterCatalog::defaults();
+    return catalog;
+}
+
+template<typename Random>
+MonsterId drawEncounter(Random& random) {
+    const MonsterCatalog& catalog = monsterCatalog();
+    return catalog.encounter(random.below(catalog.encounterRange()));
+}
+
+class Monster final : public Entity {
+private:
+    const MonsterSpec* spec;
+    MonsterId kind;
+    int exp;
+    Logger<std::string> logger;
+
+    template<CritKind Kind, typename Random>
+    void strike(Entity& hero, Random& random) {
+        int damage = attack - hero.getDefense();
+        if (damage > 0) {
+            bool crit = random.below(100) < static_cast<uint32_t>(spec->critChance);
+            int dealt = hitDamage<Kind>(damage, crit, spec->critValue);
+            hero.setHealth(hero.getHealth() - dealt);
+            if (crit) {
+                std::cout << spec->critMessage << "\n";
+            }
+            std::cout << name << " attacks " << hero.getName() << " for " << dealt << " damage!" << std::endl;
+            static LogSite site(kCombatLogRate, kCombatLogBurst);
+            logger.log<LogLevel::Debug>(site, [&] { return name + " attacks " + hero.getName() + " for " + std::to_string(dealt) + " damage!"; });
+
+            if (hero.getHealth() <= 0) {
+                std::cout << "Game over!\n" << name << " killed the hero!" << std::endl;
+                logger.log<LogLevel::Info>([&] { return "Game over! " + name + " killed the hero!"; });
+            }
+        }
+        else {
+            std::cout << name << " attacks " << hero.getName() << ", but it has no effect!" << std::endl;
+            static LogSite site(kCombatLogRate, kCombatLogBurst, kNoEffectLogSample);
+            logger.log<LogLevel::Debug>(site, [&] { return name + " attacks " + hero.getName() + ", but it has no effect!"; });
+        }
+    }
+
+public:
+    explicit Monster(MonsterId id)
+        : Entity(monsterCatalog()[id].name, monsterCatalog()[id].health, monsterCatalog()[id].attack, monsterCatalog()[id].defense),
+        spec(&monsterCatalog()[id]), kind(id), exp(spec->exp), logger("monster_log.txt") {}
+
+    MonsterId getKind() const { return kind; }
+
+    // Back to a freshly spawned monster of the same kind; keeps the open log.
+    void reset() {
+        name = spec->name;
+        health = spec->health;
+        attack = spec->attack;
+        defense = spec->defense;
+        exp = spec->exp;
+    }
+
+    void attackEnemy(Entity& hero) override {
+        attackEnemy(hero, gameRandom());
+    }
+
+    // Same attack with crits rolled from random, e.g. a SimRandom to replay a simulation.
+    template<typename Random>
+    void attackEnemy(Entity& hero, Random& random) {
+        switch (spec->critKind) {
+        case CritKind::Multiply: strike<CritKind::Multiply>(hero, random); break;
+        case CritKind::Add: strike<CritKind::Add>(hero, random); break;
+        }
+    }
+
+    void displayInfo() const override {
+        std::cout << "\nMonster Name: " << name << ", HP: " << health
+            << ", Attack: " << attack << ", Defense: " << defense << std::endl;
+    }
+
+    void gainExp(Character& hero) {
+        hero.setExperience(hero.getExperience() + exp);
+        if (hero.getExperience() >= 100) {
+            hero.setLevel(hero.getLevel() + 1);
+            hero.setExperience(0);
+            hero.setAttack(hero.getAttack() + 1);
+            hero.setHealth(100);
+            std::cout << hero.getName() << " leveled up to level " << hero.getLevel() << "!" << std::endl;
+            logger.log<LogLevel::Info>([&] { return hero.getName() + " level increased!"; });
+
+            if (hero.getLevel() % 3 == 0) {
+                hero.addToInventory(kPotion);
+                std::cout << "Potion added to inventory.\n";
+                logger.log<LogLevel::Info>([&] { return "Potion added to inventory."; });
+            }
+            else if (hero.getLevel() % 2 == 0) {
+                hero.addToInventory(kGrindstone);
+                std::cout << "Grindstone added to inventory.\n";
+                logger.log<LogLevel::Info>([&] { return "Grindstone added to inventory."; });
+            }
+        }
+    }
+
+    ~Monster() override {}
+};
+
+inline std::unique_ptr<Monster> makeMonster(MonsterId id) {
+    return std::make_unique<Monster>(id);
+}
+
+#ifdef GAME_COUNT_ALLOCATIONS
+// Counts every plain operator new in the program, so bench-pool can report allocations.
+// Replacing the global operators affects every mode, so it is opt-in at build time.
+std::atomic<uint64_t> heapAllocations{ 0 };
+
+void* operator new(size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+// GCC flags free() here once these are inlined into a delete-expression, although the
+// memory always comes from the malloc in operator new above.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+constexpr bool kCountsAllocations = true;
+inline uint64_t allocationCount() { return heapAllocations.load(std::memory_order_relaxed); }
+#else
+constexpr bool kCountsAllocations = false;
+inline uint64_t allocationCount() { return 0; }
+#endif
+
+// Spare monsters of each kind. acquire() hands out a pooled monster reset to its spec,
+// and the handle puts it back when it goes out of scope, so once every kind has been
+// met an encounter neither allocates nor opens monster_log.txt again.
+class MonsterPool {
+public:
+    struct Release {
+        MonsterPool* pool;
+        void operator()(Monster* monster) const { pool->release(monster); }
+    };
+    using Handle = std::unique_ptr<Monster, Release>;
+
+private:
+    std::vector<std::vector<std::unique_ptr<Monster>>> spare;
+
+    void release(Monster* monster) {
+        spare[monster->getKind()].emplace_back(monster);
+    }
+
+public:
+    Handle acquire(MonsterId id) {
+        if (spare.size() < monsterCatalog().size()) {
+            spare.resize(monsterCatalog().size());
+        }
+        std::vector<std::unique_ptr<Monster>>& free = spare[id];
+        if (free.empty()) {
+            return Handle(new Monster(id), Release{ this });
+        }
+        Monster* monster = free.back().release();
+        free.pop_back();
+        monster->reset();
+        return Handle(monster, Release{ this });
+    }
+};
+
+void writeVarint(std::ostream& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.put(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.put(static_cast<char>(value));
+}
+
+uint64_t readVarint(std::istream& in) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = in.get();
+        if (byte == EOF) {
+            throw std::runtime_error("Unexpected end of file");
+        }
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+    return value;
+}
+
+// Ends a recorded or replayed session early: input ran out, the replay reached its
+// target turn or the recording no longer matches the game. Not a std::exception, so
+// the error handlers inside Game let it through.
+struct SessionEnd {
+    std::string reason;
+};
+
+enum class SessionEvent : uint8_t {
+    Seed,
+    MenuChoice,
+    ActionChoice,
+    ItemChoice,
+    HeroHit,     // damage dealt by the hero
+    MonsterHit,  // damage taken by the hero
+    LoadedState  // stats read from a save file, which may be gone at replay time
+};
+
+// Event stream of one Game session. Everything random comes from gameRandom(), so the
+// seed plus the player's input is enough to re-run it; hits are kept to verify the
+// re-run. In replay mode input comes from the tape and outcomes are compared with it.
+// A recording goes to its file as it happens and is flushed before every wait for
+// input, so a session that ends in an error or a crash can still be replayed.
+class SessionTape {
+private:
+    static constexpr uint32_t kMagic = 0x43455247; // "GREC"
+    static constexpr uint32_t kVersion = 1;
+
+    std::vector<std::pair<SessionEvent, int64_t>> events;
+    std::ofstream sink;
+    bool replaying = false;
+    size_t cursor = 0;
+    long long turns = 0;
+    long long stopAtTurn = -1;
+    size_t mismatches = 0;
+    std::string firstMismatch;
+
+    int64_t next(SessionEvent type) {
+        if (cursor == events.size()) {
+            throw SessionEnd{ "end of recording" };
+        }
+        if (events[cursor].first != type) {
+            throw SessionEnd{ "recording diverged at event " + std::to_string(cursor) };
+        }
+        return events[cursor++].second;
+    }
+
+    void append(SessionEvent type, int64_t value) {
+        events.emplace_back(type, value);
+        if (sink.is_open()) {
+            sink.put(static_cast<char>(type));
+            writeVarint(sink, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+        }
+    }
+
+public:
+    // Starts a recording, written to filename unless that is empty.
+    static SessionTape record(uint64_t seed, const std::string& filename = "") {
+        SessionTape tape;
+        if (!filename.empty()) {
+            tape.sink.open(filename, std::ios::binary | std::ios::trunc);
+            if (!tape.sink) {
+                throw std::runtime_error("Unable to create session recording: " + filename);
+            }
+            writeVarint(tape.sink, kMagic);
+            writeVarint(tape.sink, kVersion);
+        }
+        tape.append(SessionEvent::Seed, static_cast<int64_t>(seed));
+        return tape;
+    }
+
+    // Name for a new recording: start time plus the seed, so sessions do not overwrite
+    // each other.
+    static std::string fileNameFor(uint64_t seed) {
+        char name[64];
+        std::snprintf(name, sizeof(name), "session-%lld-%08x.rec",
+            static_cast<long long>(std::time(nullptr)), static_cast<unsigned>(seed));
+        return name;
+    }
+
+    static SessionTape load(const std::string& filename, long long stopAtTurn = -1) {
+        std::ifstream in(filename, std::ios::binary);
+        if (!in || readVarint(in) != kMagic || readVarint(in) != kVersion) {
+            throw std::runtime_error("Not a session recording: " + filename);
+        }
+        SessionTape tape;
+        for (int type = in.get(); type != EOF; type = in.get()) {
+            if (type > static_cast<int>(SessionEvent::LoadedState)) {
+                throw std::runtime_error("Corrupt session recording: " + filename);
+            }
+            uint64_t zigzag;
+            try {
+                zigzag = readVarint(in);
+            }
+            catch (const std::runtime_error&) {
+                break; // the recording process died in the middle of its last event
+            }
+            int64_t value = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+            tape.events.emplace_back(static_cast<SessionEvent>(type), value);
+        }
+        if (tape.events.empty() || tape.events[0].first != SessionEvent::Seed) {
+            throw std::runtime_error("Session recording has no seed: " + filename);
+        }
+        tape.replaying = true;
+        tape.cursor = 1;
+        tape.stopAtTurn = stopAtTurn;
+        return tape;
+    }
+
+    bool isReplaying() const { return replaying; }
+    uint64_t seed() const { return static_cast<uint64_t>(events[0].second); }
+    size_t eventCount() const { return events.size(); }
+    size_t position() const { return cursor; }
+    long long turnCount() const { return turns; }
+    size_t mismatchCount() const { return mismatches; }
+    const std::string& describeFirstMismatch() const { return firstMismatch; }
+
+    int choice(SessionEvent type) {
+        if (replaying) {
+            return static_cast<int>(next(type));
+        }
+        if (std::cin.rdbuf()->in_avail() <= 0) {
+            sink.flush(); // about to wait for the player
+        }
+        int value;
+        if (!(std::cin >> value)) {
+            throw SessionEnd{ "input closed" };
+        }
+        std::cin.ignore();
+        append(type, value);
+        return value;
+    }
+
+    void outcome(SessionEvent type, int value) {
+        if (!replaying) {
+            append(type, value);
+            return;
+        }
+        int64_t recorded = next(type);
+        if (recorded != value && mismatches++ == 0) {
+            firstMismatch = "turn " + std::to_string(turns) + ": recorded " + std::to_string(recorded)
+                + " damage, replay dealt " + std::to_string(value);
+        }
+    }
+
+    // False once a replay has executed the requested number of turns.
+    bool beginTurn() {
+        if (replaying && turns == stopAtTurn) {
+            return false;
+        }
+        ++turns;
+        return true;
+    }
+
+    // Records the stats a load produced, or applies the recorded ones on replay.
+    void loadedState(Character& hero) {
+        if (!replaying) {
+            for (int value : { hero.getHealth(), hero.getAttack(), hero.getDefense(), hero.getLevel(), hero.getExperience() }) {
+                append(SessionEvent::LoadedState, value);
+            }
+            return;
+        }
+        hero.setHealth(static_cast<int>(next(SessionEvent::LoadedState)));
+        hero.setAttack(static_cast<int>(next(SessionEvent::LoadedState)));
+        hero.setDefense(static_cast<int>(next(SessionEvent::LoadedState)));
+        hero.setLevel(static_cast<int>(next(SessionEvent::LoadedState)));
+        hero.setExperience(static_cast<int>(next(SessionEvent::LoadedState)));
+    }
 };
 
 class Game {
 private:
     std::unique_ptr<Character> player;
     Logger<std::string> logger;
+    SessionTape& tape;
+    MonsterPool monsterPool;
+
+    void exchange(Entity& attacker, Entity& target, SessionEvent hit) {
+        int before = target.getHealth();
+        attacker.attackEnemy(target);
+        tape.outcome(hit, before - target.getHealth());
+    }
+
 public:
-    Game() : logger("game_log.txt") {
-        logger.log("Game started");
+    Game(SessionTape& tape) : logger("game_log.txt"), tape(tape) {
+        logger.log<LogLevel::Info>([&] { return "Game started"; });
         player = std::make_unique<Character>();
+        seedGameRandom(tape.seed());
     }
 
+    const Character& getPlayer() const { return *player; }
+
     void start() {
-        player->addToInventory(std::make_unique<Grindstone>());
-        player->addToInventory(std::make_unique<Potion>());
+        player->addToInventory(kGrindstone);
+        player->addToInventory(kPotion);
         std::cout << "Welcome to the game!";
         menu();
     }
@@ -438,9 +1411,7 @@ public:
             std::cout << "6. Exit\n";
             std::cout << "Choose an option: ";
 
-            int choice;
-            std::cin >> choice;
-            std::cin.ignore();
+            int choice = tape.choice(SessionEvent::MenuChoice);
 
             try {
                 switch (choice) {
@@ -448,11 +1419,16 @@ public:
                 case 2: player->displayInfo(); break;
                 case 3: player->showInventory(); break;
                 case 4:
-                    player->saveGame("save.txt");
+                    if (!tape.isReplaying()) {
+                        player->saveGame("save.txt");
+                    }
                     std::cout << "Game saved!\n";
                     break;
                 case 5:
-                    player->loadGame("save.txt");
+                    if (!tape.isReplaying()) {
+                        player->loadGame("save.txt");
+                    }
+                    tape.loadedState(*player);
                     std::cout << "Game loaded!\n";
                     break;
                 case 6: return;
@@ -470,21 +1446,7 @@ public:
     }
 
     void play() {
-        std::unique_ptr<Monster> monster;
-
-        int a = rand() % 10;
-        if (a < 3) {
-            monster = std::make_unique<Sceleton>();
-        }
-        else if (a < 6) {
-            monster = std::make_unique<Goblin>();
-        }
-        else if (a < 8) {
-            monster = std::make_unique<Troll>();
-        }
-        else{
-            monster = std::make_unique<Dragon>();
-        }
+        MonsterPool::Handle monster = monsterPool.acquire(drawEncounter(gameRandom()));
 
         std::cout << "\nYou have encountered a " << monster->getName() << ". Attack!\n";
         monster->displayInfo();
@@ -493,27 +1455,30 @@ public:
     }
 
     void fight(Monster& monster) {
-        logger.log("The beginning of the fight between " + player->getName() + " and " + monster.getName());
+        logger.log<LogLevel::Info>([&] { return "The beginning of the fight between " + player->getName() + " and " + monster.getName(); });
 
         while (player->isAlive() && monster.isAlive()) {
+            if (!tape.beginTurn()) {
+                throw SessionEnd{ "stopped before turn " + std::to_string(tape.turnCount() + 1) + " against "
+                    + monster.getName() + " (HP " + std::to_string(monster.getHealth()) + ")" };
+            }
             std::cout << player->getName() << " ===" << " HP: " << player->getHealth() << std::endl;
             std::cout << monster.getName() << " ===" << " HP: " << monster.getHealth() << std::endl;
 
             std::cout << "\n1. Attack\n";
             std::cout << "2. Use item\n";
+            std::cout << "3. Drink a potion (" << player->getInventory().count(ItemEffect::Heal) << " left)\n";
             std::cout << "Choose an action: ";
 
-            int choice;
-            std::cin >> choice;
-            std::cin.ignore();
+            int choice = tape.choice(SessionEvent::ActionChoice);
             std::cout << std::endl;
 
             try {
                 switch (choice) {
                 case 1:
-                    player->attackEnemy(monster);
+                    exchange(*player, monster, SessionEvent::HeroHit);
                     if (monster.isAlive()) {
-                        monster.attackEnemy(*player);
+                        exchange(monster, *player, SessionEvent::MonsterHit);
                     }
                     else{
                         monster.gainExp(*player);
@@ -523,18 +1488,25 @@ public:
                     player->showInventory();
                     if (player->getInventory().size() > 0) {
                         std::cout << "Enter item number to use (0 to cancel): ";
-                        int itemChoice;
-                        std::cin >> itemChoice;
-                        std::cin.ignore();
+                        int itemChoice = tape.choice(SessionEvent::ItemChoice);
                         if (itemChoice > 0 && itemChoice <= player->getInventory().size()) {
-                            player->useItem(itemChoice - 1);
-                            monster.attackEnemy(*player);
+                            player->useItem(player->getInventory().handleAt(itemChoice - 1));
+                            exchange(monster, *player, SessionEvent::MonsterHit);
                         }
                     }
                     else {
                         std::cout << "Inventory is empty!\n";
                     }
                     break;
+                case 3:
+                    if (player->getInventory().count(ItemEffect::Heal) > 0) {
+                        player->useItem(player->getInventory().firstOf(ItemEffect::Heal));
+                        exchange(monster, *player, SessionEvent::MonsterHit);
+                    }
+                    else {
+                        std::cout << "No potions left!\n";
+                    }
+                    break;
                 default:
                     std::cout << "Invalid choice!\n";
                 }
@@ -549,18 +1521,1282 @@ public:
         }
         if (player->isAlive()) {
             std::cout << "You defeated the " << monster.getName() << "!\n";
-            logger.log(player->getName() + " defeated " + monster.getName());
+            logger.log<LogLevel::Info>([&] { return player->getName() + " defeated " + monster.getName(); });
+        }
+    }
+};
+
+// Headless combat: the rules of Game::fight on plain values, without console or log I/O.
+
+// Counter-based stream per fight: draw n is a hash of (fight key, n), so results do not
+// depend on how fights are sharded and a batch can compute draws for many fights at once.
+// Only 32-bit multiplies are used so those batch passes vectorize on AVX2.
+class SimRandom {
+private:
+    uint32_t key;
+    uint32_t counter = 0;
+
+public:
+    static uint32_t hash(uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7FEB352Du;
+        x ^= x >> 15;
+        x *= 0x846CA68Bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    static uint32_t keyFor(uint64_t seed, uint64_t stream) {
+        uint64_t state = seed + stream * 0x9E3779B97F4A7C15ull;
+        return static_cast<uint32_t>(splitmix64(state));
+    }
+
+    static uint32_t draw(uint32_t key, uint32_t counter) { return hash(hash(counter) ^ key); }
+
+    // Lemire's product for one draw; the draw must be rejected if the low half is below
+    // rejectBelow(bound).
+    static uint64_t scaled(uint32_t bits, uint32_t bound) { return static_cast<uint64_t>(bits) * bound; }
+
+    static constexpr uint32_t rejectBelow(uint32_t bound) { return (0u - bound) % bound; }
+
+    SimRandom(uint64_t seed, uint64_t stream) : key(keyFor(seed, stream)) {}
+
+    SimRandom(uint32_t key, uint32_t counter) : key(key), counter(counter) {}
+
+    uint32_t getKey() const { return key; }
+    uint32_t getCounter() const { return counter; }
+
+    uint32_t next() { return draw(key, counter++); }
+
+    // Unbiased draw from [0, bound).
+    uint32_t below(uint32_t bound) {
+        uint64_t m = scaled(next(), bound);
+        while (static_cast<uint32_t>(m) < rejectBelow(bound)) {
+            m = scaled(next(), bound);
+        }
+        return static_cast<uint32_t>(m >> 32);
+    }
+};
+
+struct SimHero {
+    int health = 100;
+    int attack = 15;
+    int defense = 5;
+    int potions = 1;
+    int grindstones = 1;
+};
+
+struct SimMonster {
+    MonsterId kind;
+    int health;
+    int attack;
+    int defense;
+};
+
+enum class SimAction { Attack, UsePotion, UseGrindstone };
+
+struct AttackPolicy {
+    SimAction operator()(const SimHero&, const SimMonster&) const { return SimAction::Attack; }
+};
+
+// Sharpens first, then drinks a potion whenever health drops below a threshold.
+struct CautiousPolicy {
+    int healBelow = 40;
+
+    SimAction operator()(const SimHero& hero, const SimMonster&) const {
+        if (hero.grindstones > 0) return SimAction::UseGrindstone;
+        if (hero.potions > 0 && hero.health < healBelow) return SimAction::UsePotion;
+        return SimAction::Attack;
+    }
+};
+
+struct FightResult {
+    MonsterId kind;
+    bool heroWon;
+    int turns;
+    int damageTaken;
+};
+
+constexpr int kMaxSimTurns = 1000;
+
+template<CritKind Kind, typename Policy>
+FightResult simulateFight(SimHero hero, const MonsterSpec& spec, MonsterId kind, SimRandom& random, const Policy& policy) {
+    SimMonster monster{ kind, spec.health, spec.attack, spec.defense };
+    int startHealth = hero.health;
+    int turns = 0;
+
+    auto monsterAttacks = [&]() {
+        int damage = monster.attack - hero.defense;
+        if (damage > 0) {
+            bool crit = random.below(100) < static_cast<uint32_t>(spec.critChance);
+            hero.health -= hitDamage<Kind>(damage, crit, spec.critValue);
+        }
+    };
+
+    while (hero.health > 0 && monster.health > 0 && turns < kMaxSimTurns) {
+        ++turns;
+        SimAction action = policy(hero, monster);
+        if (action == SimAction::UsePotion && hero.potions > 0) {
+            --hero.potions;
+            hero.health = std::min(hero.health + 25, 100);
+            monsterAttacks();
+        }
+        else if (action == SimAction::UseGrindstone && hero.grindstones > 0) {
+            --hero.grindstones;
+            ++hero.attack;
+            monsterAttacks();
+        }
+        else {
+            int damage = hero.attack - monster.defense;
+            if (damage > 0) {
+                monster.health -= damage;
+            }
+            if (monster.health > 0) {
+                monsterAttacks();
+            }
+        }
+    }
+    return { kind, hero.health > 0 && monster.health <= 0, turns, startHealth - hero.health };
+}
+
+template<typename Policy>
+FightResult simulateFight(const SimHero& hero, MonsterId kind, SimRandom& random, const Policy& policy) {
+    const MonsterSpec& spec = monsterCatalog()[kind];
+    switch (spec.critKind) {
+    case CritKind::Multiply: return simulateFight<CritKind::Multiply>(hero, spec, kind, random, policy);
+    default: return simulateFight<CritKind::Add>(hero, spec, kind, random, policy);
+    }
+}
+
+struct SimStats {
+    static constexpr int kDamageBucket = 10;
+    static constexpr int kDamageBuckets = 16;
+
+    std::vector<uint64_t> fights;
+    std::vector<uint64_t> wins;
+    std::vector<uint64_t> turns;
+    std::vector<std::array<uint64_t, kDamageBuckets>> damageTaken;
+
+    SimStats(size_t kinds = monsterCatalog().size())
+        : fights(kinds), wins(kinds), turns(kinds), damageTaken(kinds) {}
+
+    void add(const FightResult& result) {
+        size_t k = static_cast<size_t>(result.kind);
+        ++fights[k];
+        wins[k] += result.heroWon;
+        turns[k] += result.turns;
+        int bucket = std::clamp(result.damageTaken / kDamageBucket, 0, kDamageBuckets - 1);
+        ++damageTaken[k][bucket];
+    }
+
+    void merge(const SimStats& other) {
+        for (size_t k = 0; k < fights.size(); ++k) {
+            fights[k] += other.fights[k];
+            wins[k] += other.wins[k];
+            turns[k] += other.turns[k];
+            for (int b = 0; b < kDamageBuckets; ++b) {
+                damageTaken[k][b] += other.damageTaken[k][b];
+            }
+        }
+    }
+
+    uint64_t total() const {
+        uint64_t sum = 0;
+        for (uint64_t f : fights) sum += f;
+        return sum;
+    }
+
+    // Lower edge of the damage bucket that holds the given fraction of fights.
+    int damagePercentile(size_t k, double fraction) const {
+        uint64_t target = static_cast<uint64_t>(fraction * fights[k]);
+        uint64_t seen = 0;
+        for (int b = 0; b < kDamageBuckets; ++b) {
+            seen += damageTaken[k][b];
+            if (seen > target) return b * kDamageBucket;
+        }
+        return (kDamageBuckets - 1) * kDamageBucket;
+    }
+
+    void print(std::ostream& out) const {
+        for (size_t k = 0; k < fights.size(); ++k) {
+            if (fights[k] == 0) continue;
+            out << monsterCatalog()[static_cast<MonsterId>(k)].name << ": fights " << fights[k]
+                << ", win rate " << 100.0 * wins[k] / fights[k] << "%"
+                << ", avg turns " << static_cast<double>(turns[k]) / fights[k]
+                << ", damage taken p50 " << damagePercentile(k, 0.5)
+                << " p90 " << damagePercentile(k, 0.9) << "\n";
+        }
+    }
+};
+
+// Runs fights [0, count) against monsters drawn like Game::play, sharded over threads.
+template<typename Policy>
+SimStats runSimulation(uint64_t count, uint64_t seed, const SimHero& hero, const Policy& policy,
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency())) {
+    std::vector<SimStats> partial(threads);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            uint64_t begin = count * t / threads;
+            uint64_t end = count * (t + 1) / threads;
+            SimStats local;
+            for (uint64_t i = begin; i < end; ++i) {
+                SimRandom random(seed, i);
+                MonsterId kind = drawEncounter(random);
+                local.add(simulateFight(hero, kind, random, policy));
+            }
+            partial[t] = local;
+        });
+    }
+    SimStats stats;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers[t].join();
+        stats.merge(partial[t]);
+    }
+    return stats;
+}
+
+// Structure-of-arrays entity storage: one array per attribute and a type tag per entity.
+// Fixed capacity keeps the arrays inside one object, where the compiler can see that
+// they never overlap.
+template<size_t Capacity>
+struct EntityStore {
+    alignas(64) std::array<int32_t, Capacity> health;
+    alignas(64) std::array<int32_t, Capacity> attack;
+    alignas(64) std::array<int32_t, Capacity> defense;
+    alignas(64) std::array<uint8_t, Capacity> type;
+};
+
+// Each slot pits heroes[i] against monsters[i] under AttackPolicy. A round resolves all
+// fights in one branch-free pass over the arrays so the compiler can vectorize it; finished
+// fights are masked out. Slots are grouped by monster type, toughest first, so each pass
+// can stop at the last fight still running. Random streams are consumed exactly as
+// simulateFight consumes them, so results match it fight for fight. The batch is large,
+// so allocate it on the heap.
+class CombatBatch {
+public:
+    static constexpr size_t kCapacity = 4096;
+
+private:
+    size_t count = 0;
+    EntityStore<kCapacity> heroes;
+    EntityStore<kCapacity> monsters;
+    alignas(64) std::array<int32_t, kCapacity> critChance;
+    alignas(64) std::array<int32_t, kCapacity> critScale;
+    alignas(64) std::array<int32_t, kCapacity> critBonus;
+    alignas(64) std::array<uint32_t, kCapacity> randomKey;
+    alignas(64) std::array<uint32_t, kCapacity> randomCounter;
+    alignas(64) std::array<int32_t, kCapacity> turns;
+    alignas(64) std::array<int32_t, kCapacity> startHealth;
+    alignas(64) std::array<int32_t, kCapacity> active;
+    alignas(64) std::array<int32_t, kCapacity> rolls;
+    alignas(64) std::array<uint32_t, kCapacity> extraDraws{};
+    std::array<uint32_t, kCapacity> slotOf;
+
+    // Crit rolls for slots [0, end). A draw is rejected once in about 45 million; those
+    // slots are redrawn one by one and remember how many extra draws they used.
+    bool drawRolls(size_t end) {
+        constexpr uint32_t kReject = SimRandom::rejectBelow(100);
+        uint32_t rejected = 0;
+        for (size_t i = 0; i < end; ++i) {
+            const uint64_t m = SimRandom::scaled(SimRandom::draw(randomKey[i], randomCounter[i]), 100);
+            rolls[i] = static_cast<int32_t>(m >> 32);
+            rejected |= static_cast<uint32_t>(static_cast<uint32_t>(m) < kReject);
+        }
+        if (!rejected) {
+            return false;
+        }
+        for (size_t i = 0; i < end; ++i) {
+            SimRandom stream(randomKey[i], randomCounter[i]);
+            rolls[i] = static_cast<int32_t>(stream.below(100));
+            extraDraws[i] = stream.getCounter() - randomCounter[i] - 1;
+        }
+        return true;
+    }
+
+    // One round for slots [0, end).
+    void resolveRound(size_t end) {
+        const bool redrawn = drawRolls(end);
+        for (size_t i = 0; i < end; ++i) {
+            const int32_t on = active[i];
+            const int32_t heroDamage = std::max(heroes.attack[i] - monsters.defense[i], 0);
+            const int32_t monsterLeft = monsters.health[i] - on * heroDamage;
+
+            const int32_t damage = monsters.attack[i] - heroes.defense[i];
+            const int32_t strikes = on & (monsterLeft > 0) & (damage > 0);
+            randomCounter[i] += strikes * (1 + extraDraws[i]);
+            const int32_t loss = rolls[i] < critChance[i] ? damage * critScale[i] + critBonus[i] : damage;
+            const int32_t heroLeft = heroes.health[i] - strikes * loss;
+
+            monsters.health[i] = monsterLeft;
+            heroes.health[i] = heroLeft;
+            turns[i] += on;
+            active[i] = on & (heroLeft > 0) & (monsterLeft > 0) & (turns[i] < kMaxSimTurns);
+        }
+        if (redrawn) {
+            std::fill(extraDraws.begin(), extraDraws.begin() + end, 0u);
+        }
+    }
+
+public:
+    // Sets up fights [firstFight, firstFight + fights), at most kCapacity of them. Monsters
+    // are drawn like Game::play unless only is given.
+    void reset(uint64_t seed, uint64_t firstFight, size_t fights, const SimHero& hero,
+        std::optional<MonsterId> only = std::nullopt) {
+        count = std::min(fights, kCapacity);
+        turns.fill(0);
+        startHealth.fill(hero.health);
+        active.fill(0);
+        std::fill(active.begin(), active.begin() + count, 1);
+
+        const MonsterCatalog& catalog = monsterCatalog();
+        std::vector<SimRandom> streams;
+        std::vector<MonsterId> kinds;
+        std::vector<size_t> next(catalog.size());
+        streams.reserve(count);
+        kinds.reserve(count);
+        for (size_t fight = 0; fight < count; ++fight) {
+            streams.emplace_back(seed, firstFight + fight);
+            kinds.push_back(only ? *only : drawEncounter(streams.back()));
+            ++next[kinds.back()];
+        }
+        // Monsters with more health roughly make for longer fights, so they go first.
+        std::vector<MonsterId> order(catalog.size());
+        std::iota(order.begin(), order.end(), MonsterId{ 0 });
+        std::stable_sort(order.begin(), order.end(),
+            [&](MonsterId x, MonsterId y) { return catalog[x].health > catalog[y].health; });
+        size_t offset = 0;
+        for (MonsterId k : order) {
+            size_t kindCount = next[k];
+            next[k] = offset;
+            offset += kindCount;
+        }
+
+        for (size_t fight = 0; fight < count; ++fight) {
+            MonsterId kind = kinds[fight];
+            const MonsterSpec& stats = catalog[kind];
+            size_t i = next[kind]++;
+            slotOf[fight] = static_cast<uint32_t>(i);
+
+            heroes.health[i] = hero.health;
+            heroes.attack[i] = hero.attack;
+            heroes.defense[i] = hero.defense;
+            heroes.type[i] = 0;
+            monsters.health[i] = stats.health;
+            monsters.attack[i] = stats.attack;
+            monsters.defense[i] = stats.defense;
+            monsters.type[i] = kind;
+
+            // hitDamage on a crit, as loss = damage * scale + bonus.
+            critChance[i] = stats.critChance;
+            critScale[i] = stats.critKind == CritKind::Multiply ? stats.critValue : 1;
+            critBonus[i] = stats.critKind == CritKind::Add ? stats.critValue : 0;
+            randomKey[i] = streams[fight].getKey();
+            randomCounter[i] = streams[fight].getCounter();
+        }
+    }
+
+    void run() {
+        size_t end = count;
+        while (end > 0) {
+            resolveRound(end);
+            while (end > 0 && !active[end - 1]) {
+                --end;
+            }
+        }
+    }
+
+    size_t size() const { return count; }
+
+    size_t wins() const {
+        size_t won = 0;
+        for (size_t i = 0; i < count; ++i) {
+            won += heroes.health[i] > 0 && monsters.health[i] <= 0;
+        }
+        return won;
+    }
+
+    // Result of the fight-th fight passed to reset().
+    FightResult result(size_t fight) const {
+        size_t i = slotOf[fight];
+        return { monsters.type[i], heroes.health[i] > 0 && monsters.health[i] <= 0,
+            turns[i], startHealth[i] - heroes.health[i] };
+    }
+};
+
+// Turns console output and logging off for its lifetime and restores both when it goes
+// out of scope, also when an exception leaves it.
+class MutedOutput {
+private:
+    LogLevel previousLevel = runtimeLogLevel.load();
+    std::ios::iostate previousState = std::cout.rdstate();
+
+public:
+    MutedOutput() {
+        setRuntimeLogLevel(LogLevel::Off);
+        std::cout.setstate(std::ios::badbit);
+    }
+
+    MutedOutput(const MutedOutput&) = delete;
+    MutedOutput& operator=(const MutedOutput&) = delete;
+
+    ~MutedOutput() {
+        std::cout.clear(previousState);
+        setRuntimeLogLevel(previousLevel);
+    }
+};
+
+// Runs the same fights through simulateFight and CombatBatch, checks they agree and
+// reports the throughput of both, each timed from seeding the fight's rolls to its
+// result. A sample also goes through Character and Monster and is timed too. The batch passes only vectorize with AVX2 enabled
+// (-O3 -mavx2, /arch:AVX2); on plain SSE2 the batch setup makes it the slower path.
+int runCombatBenchmark(int argc, char* argv[]) {
+    constexpr size_t kBatch = CombatBatch::kCapacity;
+    uint64_t count = argc > 2 ? std::stoull(argv[2]) : 4000000;
+    uint64_t seed = argc > 3 ? std::stoull(argv[3]) : 1;
+    SimHero hero;
+
+    std::vector<FightResult> expected(count);
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < count; ++i) {
+        SimRandom random(seed, i);
+        MonsterId kind = drawEncounter(random);
+        expected[i] = simulateFight(hero, kind, random, AttackPolicy());
+    }
+    double scalarSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    auto batch = std::make_unique<CombatBatch>();
+    uint64_t mismatches = 0;
+    double batchSeconds = 0;
+    for (uint64_t first = 0; first < count; first += kBatch) {
+        size_t size = static_cast<size_t>(std::min<uint64_t>(kBatch, count - first));
+        start = std::chrono::steady_clock::now();
+        batch->reset(seed, first, size, hero);
+        batch->run();
+        batchSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        for (size_t i = 0; i < size; ++i) {
+            FightResult got = batch->result(i);
+            const FightResult& want = expected[first + i];
+            if (got.kind != want.kind || got.heroWon != want.heroWon || got.turns != want.turns
+                || got.damageTaken != want.damageTaken) {
+                ++mismatches;
+            }
         }
     }
+
+    // A spread-out sample also goes through the game's own Character and Monster
+    // objects, fed the same rolls, with console and log output off.
+    constexpr uint64_t kObjectSample = 20000;
+    uint64_t step = std::max<uint64_t>(count / kObjectSample, 1);
+    uint64_t objectFights = 0;
+    uint64_t objectMismatches = 0;
+    double objectSeconds = 0;
+    {
+        MutedOutput muted;
+        Character character;
+        MonsterPool pool;
+        for (uint64_t i = 0; i < count; i += step) {
+            start = std::chrono::steady_clock::now();
+            SimRandom random(seed, i);
+            MonsterPool::Handle monster = pool.acquire(drawEncounter(random));
+            character.setHealth(hero.health);
+            character.setAttack(hero.attack);
+            character.setDefense(hero.defense);
+            int turns = 0;
+            while (character.isAlive() && monster->isAlive() && turns < kMaxSimTurns) {
+                ++turns;
+                character.attackEnemy(*monster);
+                if (monster->isAlive()) {
+                    monster->attackEnemy(character, random);
+                }
+            }
+            objectSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            const FightResult& want = expected[i];
+            if (monster->getKind() != want.kind || (character.isAlive() && !monster->isAlive()) != want.heroWon
+                || turns != want.turns || hero.health - character.getHealth() != want.damageTaken) {
+                ++objectMismatches;
+            }
+            ++objectFights;
+        }
+    }
+
+    std::cout << "Scalar simulateFight:      " << count / scalarSeconds << " fights/s\n";
+    std::cout << "SoA batches:               " << count / batchSeconds << " fights/s ("
+        << scalarSeconds / batchSeconds << "x)\n";
+    std::cout << "Character/Monster sample:  " << objectFights / objectSeconds << " fights/s\n";
+    std::cout << "Mismatched fights: " << mismatches << "\n";
+    std::cout << "Mismatched against Character/Monster objects: " << objectMismatches
+        << " of " << objectFights << "\n";
+    return mismatches == 0 && objectMismatches == 0 ? 0 : 1;
+}
+
+// Win probability of a level-N Character against each monster kind. Every cell of the
+// level x monster matrix runs CombatBatch trials (vectorized rolls included) until the
+// 95% Wilson interval of the estimate is narrower than 2 * halfWidth.
+
+// Stats of a hero that reached the level through Monster::gainExp, without items.
+inline SimHero heroAtLevel(int level) {
+    SimHero hero;
+    hero.attack += level - 1;
+    hero.potions = 0;
+    hero.grindstones = 0;
+    return hero;
+}
+
+struct WinEstimate {
+    double probability = 0;
+    double halfWidth = 0;
+    uint64_t trials = 0;
 };
 
-int main() {
+inline double wilsonHalfWidth(uint64_t wins, uint64_t trials) {
+    constexpr double z = 1.959963984540054;
+    const double n = static_cast<double>(trials);
+    const double p = wins / n;
+    return z / (1 + z * z / n) * std::sqrt(p * (1 - p) / n + z * z / (4 * n * n));
+}
+
+inline WinEstimate estimateWinRate(int level, MonsterId kind, double halfWidth, uint64_t maxTrials,
+    uint64_t seed, CombatBatch& batch) {
+    const SimHero hero = heroAtLevel(level);
+    const uint64_t cellSeed = seed ^ (static_cast<uint64_t>(level) << 32) ^ static_cast<uint64_t>(kind);
+    uint64_t wins = 0;
+    uint64_t trials = 0;
+    WinEstimate estimate;
+    do {
+        batch.reset(cellSeed, trials, CombatBatch::kCapacity, hero, kind);
+        batch.run();
+        wins += batch.wins();
+        trials += batch.size();
+        estimate.halfWidth = wilsonHalfWidth(wins, trials);
+    } while (estimate.halfWidth > halfWidth && trials < maxTrials);
+    estimate.probability = static_cast<double>(wins) / trials;
+    estimate.trials = trials;
+    return estimate;
+}
+
+int runWinEstimator(int argc, char* argv[]) {
+    int maxLevel = argc > 2 ? std::stoi(argv[2]) : 10;
+    double halfWidth = argc > 3 ? std::stod(argv[3]) : 0.005;
+    uint64_t seed = argc > 4 ? std::stoull(argv[4]) : 1;
+    if (maxLevel < 1 || !(halfWidth > 0)) {
+        std::cerr << "Usage: 9_0 estimate [maxLevel >= 1] [halfWidth > 0] [seed]\n";
+        return 1;
+    }
+    constexpr uint64_t kMaxTrials = 50000000;
+
+    const size_t kinds = monsterCatalog().size();
+    std::vector<WinEstimate> matrix(static_cast<size_t>(maxLevel) * kinds);
+    std::atomic<size_t> nextCell{ 0 };
+    std::vector<std::thread> workers;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&]() {
+            auto batch = std::make_unique<CombatBatch>();
+            for (size_t cell = nextCell++; cell < matrix.size(); cell = nextCell++) {
+                int level = static_cast<int>(cell / kinds) + 1;
+                MonsterId kind = static_cast<MonsterId>(cell % kinds);
+                matrix[cell] = estimateWinRate(level, kind, halfWidth, kMaxTrials, seed, *batch);
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t trials = 0;
+    std::cout << "Level";
+    for (size_t k = 0; k < kinds; ++k) {
+        std::cout << "\t" << monsterCatalog()[static_cast<MonsterId>(k)].name;
+    }
+    std::cout << "\n";
+    std::cout.setf(std::ios::fixed);
+    std::cout.precision(4);
+    for (int level = 1; level <= maxLevel; ++level) {
+        std::cout << level;
+        for (size_t k = 0; k < kinds; ++k) {
+            const WinEstimate& estimate = matrix[(level - 1) * kinds + k];
+            std::cout << "\t" << estimate.probability << " +-" << estimate.halfWidth;
+            trials += estimate.trials;
+        }
+        std::cout << "\n";
+    }
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << trials << " trials in " << seconds << " s\n";
+    return 0;
+}
+
+// Compares gameRandom() with the rand() % 100 rolls it replaced.
+int runRandomBenchmark() {
+    constexpr int kDraws = 100000000;
+    uint64_t sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kDraws; ++i) {
+        sink += rand() % 100;
+    }
+    double randSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    FastRandom& random = gameRandom();
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kDraws; ++i) {
+        sink += random.below(100);
+    }
+    double fastSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "rand() % 100:   " << kDraws / randSeconds << " draws/s\n";
+    std::cout << "FastRandom:     " << kDraws / fastSeconds << " draws/s (" << randSeconds / fastSeconds << "x)\n";
+    return sink == 0 ? 1 : 0;
+}
+
+int runSimulationTool(int argc, char* argv[]) {
+    uint64_t count = argc > 2 ? std::stoull(argv[2]) : 10000000;
+    uint64_t seed = argc > 3 ? std::stoull(argv[3]) : 1;
+    std::string policy = argc > 4 ? argv[4] : "attack";
+
+    auto start = std::chrono::steady_clock::now();
+    SimStats stats = policy == "cautious"
+        ? runSimulation(count, seed, SimHero(), CautiousPolicy())
+        : runSimulation(count, seed, SimHero(), AttackPolicy());
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    stats.print(std::cout);
+    std::cout << stats.total() << " fights in " << seconds << " s ("
+        << static_cast<uint64_t>(stats.total() / seconds * 60) << " fights/min)\n";
+    return 0;
+}
+
+// "replay <recording> [turn]" re-runs a recorded session with console and log output
+// muted, optionally stopping before the given turn; "verify <recording>" replays it to
+// the end and fails if any hit differs from the recording.
+int runReplayTool(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: 9_0 replay <recording> [turn] | 9_0 verify <recording>\n";
+        return 1;
+    }
+    bool verify = std::string(argv[1]) == "verify";
+    long long stopAtTurn = !verify && argc > 3 ? std::stoll(argv[3]) : -1;
+    SessionTape tape = SessionTape::load(argv[2], stopAtTurn);
+
+    LogLevel previousLevel = runtimeLogLevel.load();
+    auto restoreConsole = [&] {
+        std::cout.clear();
+        std::cerr.clear();
+        setRuntimeLogLevel(previousLevel);
+    };
+    setRuntimeLogLevel(LogLevel::Off);
+    std::cout.setstate(std::ios::badbit);
+    std::cerr.setstate(std::ios::badbit);
+
+    std::string reason = "session exited";
+    auto start = std::chrono::steady_clock::now();
+    Game game(tape);
     try {
-        Game game;
         game.start();
     }
+    catch (const SessionEnd& end) {
+        reason = end.reason;
+    }
+    catch (...) {
+        restoreConsole();
+        throw;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    restoreConsole();
+
+    std::cout << "Replayed " << tape.turnCount() << " turns (" << tape.position() << " of "
+        << tape.eventCount() << " events) in " << seconds * 1000 << " ms: " << reason << "\n";
+    game.getPlayer().displayInfo();
+    if (tape.mismatchCount() > 0) {
+        std::cout << tape.mismatchCount() << " hits differ from the recording, first at "
+            << tape.describeFirstMismatch() << "\n";
+    }
+    if (verify) {
+        bool ok = tape.mismatchCount() == 0 && tape.position() == tape.eventCount();
+        std::cout << (ok ? "Recording verified\n" : "Recording does not match this build\n");
+        return ok ? 0 : 1;
+    }
+    return 0;
+}
+
+// "bench-pool [encounters]": time per encounter with a fresh make_unique monster versus
+// a pooled one, plus heap allocations in builds with GAME_COUNT_ALLOCATIONS. Console and
+// log output are off, so only the monster's own cost is measured.
+int runPoolBenchmark(uint64_t encounters) {
+    LogLevel previousLevel = runtimeLogLevel.load();
+    setRuntimeLogLevel(LogLevel::Off);
+    std::cout.setstate(std::ios::badbit);
+
+    Character hero;
+    seedGameRandom(1);
+    auto encounter = [&](Monster& monster) {
+        hero.setHealth(100);
+        while (hero.isAlive() && monster.isAlive()) {
+            hero.attackEnemy(monster);
+            if (monster.isAlive()) {
+                monster.attackEnemy(hero);
+            }
+        }
+    };
+    auto measure = [&](auto&& run) {
+        uint64_t allocationsBefore = allocationCount();
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < encounters; ++i) {
+            run(drawEncounter(gameRandom()));
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return std::make_pair(static_cast<double>(allocationCount() - allocationsBefore) / encounters,
+            seconds * 1e9 / encounters);
+    };
+
+    auto fresh = measure([&](MonsterId id) {
+        std::unique_ptr<Monster> monster = makeMonster(id);
+        encounter(*monster);
+    });
+    MonsterPool pool;
+    for (MonsterId id = 0; id < monsterCatalog().size(); ++id) {
+        pool.acquire(id);
+    }
+    auto pooled = measure([&](MonsterId id) {
+        MonsterPool::Handle monster = pool.acquire(id);
+        encounter(*monster);
+    });
+
+    std::cout.clear();
+    setRuntimeLogLevel(previousLevel);
+    if (kCountsAllocations) {
+        std::cout << "make_unique: " << fresh.first << " allocations, " << fresh.second << " ns per encounter\n";
+        std::cout << "MonsterPool: " << pooled.first << " allocations, " << pooled.second << " ns per encounter\n";
+    }
+    else {
+        std::cout << "make_unique: " << fresh.second << " ns per encounter\n";
+        std::cout << "MonsterPool: " << pooled.second << " ns per encounter\n";
+        std::cout << "(build with -DGAME_COUNT_ALLOCATIONS to count heap allocations)\n";
+    }
+    return 0;
+}
+
+// "bench-inventory [threads] [operations]": threads share a few inventories and run a
+// mix of loot drops, item use and trades between two random inventories. The plain
+// Inventory behind one mutex is the baseline; ConcurrentInventory must also keep the
+// total item count equal to drops minus uses, since trades only move items.
+int runInventoryBenchmark(unsigned maxThreads, uint64_t operations) {
+    constexpr size_t kInventories = 8;
+    LogLevel previousLevel = runtimeLogLevel.load();
+    setRuntimeLogLevel(LogLevel::Off);
+
+    auto measure = [&](unsigned threads, auto&& operation) {
+        std::vector<std::thread> workers;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                FastRandom random(7, t);
+                for (uint64_t i = t; i < operations; i += threads) {
+                    operation(random);
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        return operations / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    std::cout << "threads  mutex+Inventory ops/s  ConcurrentInventory ops/s\n";
+    bool conserved = true;
+    for (unsigned threads = 1; threads <= maxThreads; ++threads) {
+        std::mutex lock;
+        std::vector<std::unique_ptr<Inventory>> plain;
+        for (size_t i = 0; i < kInventories; ++i) {
+            plain.push_back(std::make_unique<Inventory>());
+        }
+        double baseline = measure(threads, [&](FastRandom& random) {
+            uint64_t roll = random.next();
+            Inventory& a = *plain[roll % kInventories];
+            Inventory& b = *plain[(roll >> 8) % kInventories];
+            ItemId id = static_cast<ItemId>((roll >> 16) % 2);
+            std::lock_guard<std::mutex> guard(lock);
+            switch ((roll >> 24) % 4) {
+            case 0:
+            case 1:
+                a.addItem(id);
+                break;
+            case 2:
+                a.removeItem(a.firstOf(itemCatalog()[id].name));
+                break;
+            default:
+                if (a.count(id) > 0 && b.count(static_cast<ItemId>(1 - id)) > 0) {
+                    a.removeItem(a.firstOf(itemCatalog()[id].name));
+                    b.removeItem(b.firstOf(itemCatalog()[1 - id].name));
+                    b.addItem(id);
+                    a.addItem(static_cast<ItemId>(1 - id));
+                }
+            }
+        });
+
+        std::vector<std::unique_ptr<ConcurrentInventory>> shared;
+        for (size_t i = 0; i < kInventories; ++i) {
+            shared.push_back(std::make_unique<ConcurrentInventory>());
+        }
+        std::atomic<uint64_t> net{ 0 };
+        double concurrent = measure(threads, [&](FastRandom& random) {
+            uint64_t roll = random.next();
+            ConcurrentInventory& a = *shared[roll % kInventories];
+            ConcurrentInventory& b = *shared[(roll >> 8) % kInventories];
+            ItemId id = static_cast<ItemId>((roll >> 16) % 2);
+            switch ((roll >> 24) % 4) {
+            case 0:
+            case 1:
+                a.addItem(id);
+                net.fetch_add(1, std::memory_order_relaxed);
+                break;
+            case 2:
+                if (a.removeItem(id)) {
+                    net.fetch_sub(1, std::memory_order_relaxed);
+                }
+                break;
+            default:
+                ConcurrentInventory::trade(a, id, 1, b, static_cast<ItemId>(1 - id), 1);
+            }
+        });
+        uint64_t total = 0;
+        for (const auto& inventory : shared) {
+            total += inventory->count(kGrindstone) + inventory->count(kPotion);
+        }
+        conserved = conserved && total == net.load();
+        std::cout << threads << "        " << static_cast<uint64_t>(baseline) << "                  "
+            << static_cast<uint64_t>(concurrent) << "\n";
+    }
+
+    setRuntimeLogLevel(previousLevel);
+    std::cout << (conserved ? "Item totals conserved\n" : "Item totals DIFFER\n");
+    return conserved ? 0 : 1;
+}
+
+// Read-only memory mapping of a log file.
+class MappedFile {
+private:
+    const char* data = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+
+public:
+    MappedFile(const std::string& filename) {
+#ifdef _WIN32
+        file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Failed to open log file: " + filename);
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize)) {
+            CloseHandle(file);
+            throw std::runtime_error("Failed to read size of log file: " + filename);
+        }
+        length = static_cast<size_t>(fileSize.QuadPart);
+        if (length > 0) {
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping == nullptr) {
+                CloseHandle(file);
+                throw std::runtime_error("Failed to map log file: " + filename);
+            }
+            data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        }
+#else
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open log file: " + filename);
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            close(fd);
+            throw std::runtime_error("Failed to read size of log file: " + filename);
+        }
+        length = static_cast<size_t>(info.st_size);
+        if (length > 0) {
+            void* view = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+            if (view == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("Failed to map log file: " + filename);
+            }
+            data = static_cast<const char*>(view);
+        }
+        close(fd);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* begin() const { return data; }
+    size_t size() const { return length; }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (data) munmap(const_cast<char*>(data), length);
+#endif
+    }
+};
+
+inline long long daysFromCivil(long long y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const long long era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<long long>(doe) - 719468;
+}
+
+// Parses the "Www Mmm dd hh:mm:ss yyyy" stamp Logger writes. Log times are wall-clock
+// times, so they are turned into seconds without any time zone adjustment.
+inline bool parseLogTime(const char* p, size_t n, long long& seconds) {
+    static const char* months = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    if (n < 24) {
+        return false;
+    }
+    const char* month = std::search(months, months + 36, p + 4, p + 7);
+    if (month == months + 36) {
+        return false;
+    }
+    auto number = [p](int from, int count) {
+        int value = 0;
+        for (int i = from; i < from + count; ++i) {
+            value = p[i] == ' ' ? value : value * 10 + (p[i] - '0');
+        }
+        return value;
+    };
+    long long days = daysFromCivil(number(20, 4), static_cast<unsigned>((month - months) / 3 + 1), number(8, 2));
+    seconds = days * 86400 + number(11, 2) * 3600 + number(14, 2) * 60 + number(17, 2);
+    return true;
+}
+
+// Accepts epoch seconds or "YYYY-MM-DD HH:MM:SS" (a 'T' separator works too).
+inline long long parseQueryTime(const std::string& text) {
+    if (text.find('-') == std::string::npos) {
+        return std::stoll(text);
+    }
+    int y = 0, mo = 0, d = 0, h = 0, mi = 0, sec = 0;
+    char sep = ' ';
+    if (std::sscanf(text.c_str(), "%d-%d-%d%c%d:%d:%d", &y, &mo, &d, &sep, &h, &mi, &sec) < 3) {
+        throw std::invalid_argument("Bad time: " + text);
+    }
+    return daysFromCivil(y, mo, d) * 86400 + h * 3600 + mi * 60 + sec;
+}
+
+// Sidecar index for a log written by Logger: a sparse timestamp -> offset table (one
+// entry per distinct second) and, for every capitalized word of the message, the
+// offsets of the lines that mention it. Logs are append-only, so update() resumes from
+// the last indexed byte.
+class LogIndex {
+private:
+    static constexpr uint32_t kMagic = 0x58494C47; // "GLIX"
+    static constexpr uint32_t kVersion = 1;
+
+    uint64_t indexedBytes = 0;
+    bool monotonic = true;
+    std::vector<std::pair<long long, uint64_t>> timeIndex;
+    std::unordered_map<std::string, std::vector<uint64_t>> postings;
+
+    static const char* messageStart(const char* line, const char* end) {
+        const char* p = std::find(line, end, ']');
+        if (p == end) {
+            return line;
+        }
+        p += 2;
+        if (p < end && *p == '[') {
+            p = std::find(p, end, ']');
+            p = p == end ? end : p + 2;
+        }
+        return std::min(p, end);
+    }
+
+    void indexLine(const char* line, const char* end, uint64_t offset) {
+        long long seconds;
+        if (end - line > 1 && line[0] == '[' && parseLogTime(line + 1, end - line - 1, seconds)) {
+            if (timeIndex.empty() || timeIndex.back().first != seconds) {
+                if (!timeIndex.empty() && seconds < timeIndex.back().first) {
+                    monotonic = false;
+                }
+                timeIndex.emplace_back(seconds, offset);
+            }
+        }
+
+        const char* p = messageStart(line, end);
+        while (p < end) {
+            while (p < end && !std::isalnum(static_cast<unsigned char>(*p))) ++p;
+            const char* word = p;
+            while (p < end && (std::isalnum(static_cast<unsigned char>(*p)) || *p == '_')) ++p;
+            if (p > word && std::isupper(static_cast<unsigned char>(*word))) {
+                std::vector<uint64_t>& list = postings[std::string(word, p)];
+                if (list.empty() || list.back() != offset) {
+                    list.push_back(offset);
+                }
+            }
+        }
+    }
+
+public:
+    static std::string sidecarName(const std::string& logName) { return logName + ".idx"; }
+
+    uint64_t size() const { return indexedBytes; }
+
+    // Indexes complete lines past the previously indexed prefix.
+    void update(const MappedFile& log) {
+        if (log.size() < indexedBytes) {
+            *this = LogIndex();
+        }
+        const char* base = log.begin();
+        const char* p = base + indexedBytes;
+        const char* end = base + log.size();
+        while (p < end) {
+            const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            if (!eol) {
+                break;
+            }
+            const char* lineEnd = (eol > p && eol[-1] == '\r') ? eol - 1 : eol;
+            indexLine(p, lineEnd, static_cast<uint64_t>(p - base));
+            p = eol + 1;
+        }
+        indexedBytes = static_cast<uint64_t>(p - base);
+    }
+
+    void save(const std::string& filename) const {
+        std::ofstream out(filename, std::ios::binary);
+        if (!out) {
+            throw std::runtime_error("Unable to write log index: " + filename);
+        }
+        writeVarint(out, kMagic);
+        writeVarint(out, kVersion);
+        writeVarint(out, indexedBytes);
+        writeVarint(out, monotonic ? 1 : 0);
+        writeVarint(out, timeIndex.size());
+        long long lastTime = 0;
+        uint64_t lastOffset = 0;
+        for (const auto& [seconds, offset] : timeIndex) {
+            long long delta = seconds - lastTime;
+            writeVarint(out, (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63));
+            writeVarint(out, offset - lastOffset);
+            lastTime = seconds;
+            lastOffset = offset;
+        }
+        writeVarint(out, postings.size());
+        for (const auto& [name, list] : postings) {
+            writeVarint(out, name.size());
+            out.write(name.data(), name.size());
+            writeVarint(out, list.size());
+            uint64_t previous = 0;
+            for (uint64_t offset : list) {
+                writeVarint(out, offset - previous);
+                previous = offset;
+            }
+        }
+    }
+
+    // Leaves the index empty unless the whole sidecar reads back consistently, so a
+    // truncated or corrupt file is rebuilt from the log. readVarint may throw.
+    bool load(const std::string& filename) {
+        *this = LogIndex();
+        std::ifstream in(filename, std::ios::binary | std::ios::ate);
+        if (!in) {
+            return false;
+        }
+        uint64_t fileSize = static_cast<uint64_t>(in.tellg());
+        in.seekg(0);
+        if (readVarint(in) != kMagic || readVarint(in) != kVersion) {
+            return false;
+        }
+        // Every entry takes at least a byte, which bounds the counts of a corrupt file.
+        LogIndex loaded;
+        loaded.indexedBytes = readVarint(in);
+        loaded.monotonic = readVarint(in) != 0;
+        uint64_t times = readVarint(in);
+        if (times > fileSize) {
+            return false;
+        }
+        loaded.timeIndex.resize(times);
+        long long lastTime = 0;
+        uint64_t lastOffset = 0;
+        for (auto& [seconds, offset] : loaded.timeIndex) {
+            uint64_t zigzag = readVarint(in);
+            lastTime += static_cast<long long>(zigzag >> 1) ^ -static_cast<long long>(zigzag & 1);
+            lastOffset += readVarint(in);
+            if (lastOffset >= loaded.indexedBytes) {
+                return false;
+            }
+            seconds = lastTime;
+            offset = lastOffset;
+        }
+        uint64_t names = readVarint(in);
+        if (names > fileSize) {
+            return false;
+        }
+        for (uint64_t i = 0; i < names; ++i) {
+            uint64_t nameLength = readVarint(in);
+            if (nameLength > fileSize) {
+                return false;
+            }
+            std::string name(nameLength, '\0');
+            in.read(name.data(), name.size());
+            uint64_t count = readVarint(in);
+            if (!in || count > fileSize) {
+                return false;
+            }
+            std::vector<uint64_t>& list = loaded.postings[name];
+            list.resize(count);
+            uint64_t previous = 0;
+            for (uint64_t& offset : list) {
+                previous += readVarint(in);
+                if (previous >= loaded.indexedBytes) {
+                    return false;
+                }
+                offset = previous;
+            }
+        }
+        if (!in) {
+            return false;
+        }
+        *this = std::move(loaded);
+        return true;
+    }
+
+    // Calls visit(line) for every line mentioning entity with a timestamp in [from, to].
+    template<typename F>
+    size_t query(const MappedFile& log, const std::string& entity, long long from, long long to, F&& visit) const {
+        auto it = postings.find(entity);
+        if (it == postings.end()) {
+            return 0;
+        }
+        const std::vector<uint64_t>& list = it->second;
+        auto first = list.begin();
+        auto last = list.end();
+        if (monotonic) {
+            auto lo = std::lower_bound(timeIndex.begin(), timeIndex.end(), from,
+                [](const auto& entry, long long t) { return entry.first < t; });
+            auto hi = std::upper_bound(timeIndex.begin(), timeIndex.end(), to,
+                [](long long t, const auto& entry) { return t < entry.first; });
+            uint64_t loOffset = lo == timeIndex.end() ? indexedBytes : lo->second;
+            uint64_t hiOffset = hi == timeIndex.end() ? indexedBytes : hi->second;
+            first = std::lower_bound(list.begin(), list.end(), loOffset);
+            last = std::lower_bound(first, list.end(), hiOffset);
+        }
+
+        size_t matches = 0;
+        const char* base = log.begin();
+        const char* end = base + std::min<uint64_t>(indexedBytes, log.size());
+        for (auto offset = first; offset != last; ++offset) {
+            const char* line = base + *offset;
+            const char* eol = static_cast<const char*>(std::memchr(line, '\n', end - line));
+            const char* lineEnd = eol ? eol : end;
+            if (lineEnd > line && lineEnd[-1] == '\r') --lineEnd;
+            long long seconds;
+            if (!monotonic && !(parseLogTime(line + 1, lineEnd - line - 1, seconds) && seconds >= from && seconds <= to)) {
+                continue;
+            }
+            visit(std::string_view(line, lineEnd - line));
+            ++matches;
+        }
+        return matches;
+    }
+};
+
+// Loads the sidecar index of logName, brings it up to date with the log and saves it back.
+// A sidecar that cannot be read is rebuilt from scratch.
+inline LogIndex openLogIndex(const MappedFile& log, const std::string& logName) {
+    LogIndex index;
+    uint64_t before = 0;
+    try {
+        if (index.load(LogIndex::sidecarName(logName))) {
+            before = index.size();
+        }
+    }
+    catch (const std::exception&) {
+        index = LogIndex();
+    }
+    index.update(log);
+    if (index.size() != before || before == 0) {
+        index.save(LogIndex::sidecarName(logName));
+    }
+    return index;
+}
+
+int runLogTool(int argc, char* argv[]) {
+    std::string mode = argv[1];
+    if (mode == "index" && argc == 3) {
+        MappedFile log(argv[2]);
+        LogIndex index = openLogIndex(log, argv[2]);
+        std::cout << "Indexed " << index.size() << " bytes of " << argv[2] << "\n";
+        return 0;
+    }
+    if (mode == "query" && argc == 6) {
+        MappedFile log(argv[2]);
+        LogIndex index = openLogIndex(log, argv[2]);
+        size_t found = index.query(log, argv[3], parseQueryTime(argv[4]), parseQueryTime(argv[5]),
+            [](std::string_view line) { std::cout << line << "\n"; });
+        std::cout << found << " events\n";
+        return 0;
+    }
+    std::cerr << "Usage: " << argv[0] << " index <log>\n"
+        << "       " << argv[0] << " query <log> <entity> <from> <to>\n";
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    std::string recording;
+    try {
+        if (std::ifstream("9_0.monsters.txt")) {
+            monsterCatalog() = MonsterCatalog::load("9_0.monsters.txt");
+        }
+        if (argc > 1 && std::string(argv[1]) == "simulate") {
+            return runSimulationTool(argc, argv);
+        }
+        if (argc > 1 && std::string(argv[1]) == "estimate") {
+            return runWinEstimator(argc, argv);
+        }
+        if (argc > 1 && std::string(argv[1]) == "bench-rng") {
+            return runRandomBenchmark();
+        }
+        if (argc > 1 && std::string(argv[1]) == "bench-pool") {
+            return runPoolBenchmark(argc > 2 ? std::stoull(argv[2]) : 1000000);
+        }
+        if (argc > 1 && std::string(argv[1]) == "bench-inventory") {
+            unsigned threads = argc > 2 ? std::stoul(argv[2]) : std::max(std::thread::hardware_concurrency(), 1u);
+            return runInventoryBenchmark(threads, argc > 3 ? std::stoull(argv[3]) : 2000000);
+        }
+        if (argc > 1 && std::string(argv[1]) == "bench-soa") {
+            return runCombatBenchmark(argc, argv);
+        }
+        if (argc > 1 && (std::string(argv[1]) == "replay" || std::string(argv[1]) == "verify")) {
+            return runReplayTool(argc, argv);
+        }
+        if (argc > 1) {
+            return runLogTool(argc, argv);
+        }
+        // Every session is recorded so a reported bug can be replayed.
+        uint64_t seed = std::random_device{}();
+        recording = SessionTape::fileNameFor(seed);
+        SessionTape tape = SessionTape::record(seed, recording);
+        Game game(tape);
+        try {
+            game.start();
+        }
+        catch (const SessionEnd&) {
+        }
+        std::cout << "Session recorded to " << recording << "\n";
+    }
     catch (const std::exception& e) {
         std::cerr << "Fatal error: " << e.what() << "\n";
+        if (!recording.empty()) {
+            std::cerr << "Session recorded to " << recording << "\n";
+        }
         return 1;
     }
 